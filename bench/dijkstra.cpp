@@ -0,0 +1,121 @@
+#include <chrono>
+#include <random>
+#include <filesystem>
+
+#include <fmt/format.h>
+
+#include "map.hpp"
+#include "phast.hpp"
+#include "scheduler.hpp"
+
+namespace fs = std::filesystem;
+
+using namespace graphs;
+
+/**
+ * Run Graph::dijkstra with the given queue policy from every source.
+ *
+ * @return Milliseconds per query and the sum of finite distances to cross-check policies.
+ */
+template<typename Search>
+auto measure(const std::vector<Graph::Index>& sources, Search&& search)
+-> std::pair<double, long double> {
+    long double checksum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (auto s: sources) {
+        const auto[distances, _] = search(s);
+        for (auto d: distances) { checksum += d < Graph::INF ? d : 0; }
+    }
+    const auto time = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return { time / sources.size(), checksum };
+}
+
+template<typename Queue>
+auto measure(const Graph& graph, const std::vector<Graph::Index>& sources)
+-> std::pair<double, long double> {
+    return measure(sources, [&](auto s) { return graph.dijkstra<Queue>(s); });
+}
+
+/**
+ * Compare priority queue policies, batched searches, parallel delta-stepping and PHAST sweeps
+ * on one-to-all searches.
+ *
+ * Usage: graphs-bench [file.pbf] [number of sources]
+ */
+int main(int argc, const char** argv) {
+    const fs::path filename = argc > 1 ? argv[1] : "NNMap.pbf";
+    const auto num = argc > 2 ? std::stoul(argv[2]) : 100;
+
+    if (!fs::exists(".cache")) { fs::create_directory(".cache"); }
+    const auto cache_name = filename.stem();
+    const auto recache = !fs::exists((fs::path { ".cache" } / cache_name) += "-map.dmp")
+                         || !fs::exists((fs::path { ".cache" } / cache_name) += "-gph.dmp");
+    const auto map = import_map_from_pbf(filename, recache);
+    if (!map) {
+        fmt::print(stderr, "Map not found");
+        return 1;
+    }
+
+    const auto& graph = map->graph();
+    if (graph.size() == 0) {
+        fmt::print(stderr, "Map has no routing nodes");
+        return 1;
+    }
+    std::mt19937 random { 42 };
+    const auto last = static_cast<Graph::Index>(graph.size() - 1);
+    std::uniform_int_distribution<Graph::Index> uniform { 0, last };
+    std::vector<Graph::Index> sources(num);
+    for (auto& s: sources) { s = uniform(random); }
+
+    fmt::print("{} nodes, {} edges, {} sources\n", graph.size(), graph.edges_count(), num);
+
+    const auto report = [](const char* name, std::pair<double, long double> result) {
+        fmt::print("{:>16}: {:10.3f} ms/query (checksum {:.1f})\n", name, result.first,
+                   static_cast<double>(result.second));
+    };
+    report("4-ary heap", measure<QuaternaryHeap>(graph, sources));
+    report("lazy binary heap", measure<LazyBinaryHeap>(graph, sources));
+    report("radix heap", measure<RadixHeap>(graph, sources));
+
+    const auto batched = [&] {
+        long double checksum = 0;
+        const auto start = std::chrono::steady_clock::now();
+        const auto order = graph.z_order(sources);
+        for (std::size_t first = 0; first < sources.size(); first += Graph::LANES) {
+            std::vector<Graph::Index> batch;
+            for (auto i = first; i < std::min(sources.size(), first + Graph::LANES); i += 1) {
+                batch.push_back(sources[order[i]]);
+            }
+            for (const auto& distances: graph.batched_dijkstra(batch)) {
+                for (auto d: distances) { checksum += d < Graph::INF ? d : 0; }
+            }
+        }
+        const auto time = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        return std::pair { time / sources.size(), checksum };
+    };
+    report(fmt::format("batched x{}", Graph::LANES).c_str(), batched());
+
+    Scheduler scheduler;
+    report(fmt::format("delta x{}", scheduler.size()).c_str(),
+           measure(sources, [&](auto s) { return graph.delta_stepping(s, scheduler); }));
+
+    // Single sources sweep one lane, batches share the interleaved sweep of all lanes.
+    if (map->hierarchy().empty()) { return 0; }
+    const Phast phast { map->hierarchy() };
+    report("phast x1", measure(sources, [&](auto s) {
+        return std::pair { phast.distances(s), Graph::Trail {} };
+    }));
+    const auto swept = [&] {
+        long double checksum = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto& distances: phast.distances(sources)) {
+            for (auto d: distances) { checksum += d < Graph::INF ? d : 0; }
+        }
+        const auto time = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+        return std::pair { time / sources.size(), checksum };
+    };
+    report(fmt::format("phast x{}", Phast::LANES).c_str(), swept());
+}
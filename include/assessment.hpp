@@ -2,7 +2,13 @@
 #define ASSESSMENT_HPP
 
 #include "map.hpp"
+#include "scheduler.hpp"
 
+/**
+ * Run the accessibility queries on the process-wide scheduler and write them to report.txt.
+ * Minmax and median are read off one distance table per direction in a single pass; the
+ * report does not depend on the number of workers.
+ */
 void assessment(const graphs::Map& map, int nodes, int objects);
 
 #endif // ASSESSMENT_HPP
@@ -49,17 +49,17 @@ struct Building {
     [[nodiscard]] auto longitude() const { return m_longitude; }
 
 private:
-    enum class Type {
+    enum class Type: std::uint8_t {
         House,
         Facility,
         Other
     };
 
     std::uint64_t m_id = 0;
-    Type m_type = Type::House;
     Angle m_latitude = 0;
     Angle m_longitude = 0;
     Node m_closest_node {};
+    Type m_type = Type::House;
 };
 
 /**
@@ -95,14 +95,8 @@ namespace std {
 template<>
 struct hash<graphs::Building> {
     size_t operator()(const graphs::Building& b) const {
-        using boost::hash_value;
-        using boost::hash_combine;
-
-        size_t seed = 0;
-        hash_combine(seed, hash_value(b.id()));
-        hash_combine(seed, hash_value(b.latitude()));
-        hash_combine(seed, hash_value(b.longitude()));
-        return seed;
+        // Equality is defined by OSM id only, so the coordinates need not be hashed.
+        return boost::hash_value(b.id());
     }
 };
 } // namespace std
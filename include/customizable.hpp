@@ -0,0 +1,162 @@
+#ifndef GRAPHS_CUSTOMIZABLE_HPP
+#define GRAPHS_CUSTOMIZABLE_HPP
+
+#include <memory>
+
+#include "graph.hpp"
+
+namespace fs = std::filesystem;
+
+namespace graphs {
+/**
+ * Customizable Contraction Hierarchy: the order and the arcs depend on the topology of
+ * the Graph only, the weights are applied afterwards and can be replaced at any time.
+ *
+ * Order is a geometric nested dissection: nodes are split in halves by the median latitude
+ * or longitude, the boundary of the half with fewer boundary nodes separates them and goes
+ * above both, and the halves are ordered the same way; of the two coordinates the one with
+ * the smaller separator is taken. Contracting in that order with every shortcut kept (no
+ * witness searches) gives the arcs; the higher neighbours of a node all lie on its path up
+ * the elimination tree, the lowest of them being its parent.
+ *
+ * Customization sets the arcs to the weights of the edges and then improves every arc
+ * through its lower triangles. Arcs of the nodes on one level of the elimination tree only
+ * depend on the levels below, so each level is customized in parallel. The weights are
+ * filled into a new metric that is published at once: a query keeps the metric current at
+ * its start, so queries run on during an update and see the new weights right after it.
+ */
+struct CustomizableHierarchy {
+    using Index = Graph::Index;
+
+    /**
+     * Weights of the arcs from their lower ranked end (up) and to it (down), and for each the
+     * lower arc of the triangle that gave the weight, NONE if the weight is the edge's own.
+     */
+    struct Metric {
+        std::vector<Distance> up {};
+        std::vector<Distance> down {};
+        std::vector<Index> via_up {};
+        std::vector<Index> via_down {};
+        /**
+         * Number of customizations up to this one.
+         */
+        std::size_t version = 0;
+    };
+
+    CustomizableHierarchy() = default;
+
+    /**
+     * Order and contract the graph; queries need a customize() first.
+     */
+    explicit CustomizableHierarchy(const Graph& graph);
+
+    /**
+     * Order and arcs only, the metric has to be customized again after deserialization.
+     */
+    bool serialize(const fs::path& filename) const;
+    /**
+     * Load the dump of the graph with the given Graph::fingerprint, false if it is missing
+     * or was built from another graph.
+     */
+    bool deserialize(const fs::path& filename, std::uint64_t fingerprint);
+
+    [[nodiscard]] bool empty() const { return m_rank.empty(); }
+    [[nodiscard]] std::size_t size() const { return m_rank.size(); }
+    [[nodiscard]] std::size_t arcs_count() const { return m_heads.size(); }
+
+    /**
+     * Position of the node in the nested dissection order.
+     */
+    [[nodiscard]] Index rank(Index v) const { return m_rank[v]; }
+
+    /**
+     * Apply new weights of the edges, indexed like Graph::weights() of the ordered graph.
+     * May run while queries do, they finish on the metric they started with.
+     * Throws std::invalid_argument if the number of weights is not the number of edges.
+     */
+    void customize(const std::vector<Distance>& weights);
+
+    /**
+     * Current metric, nullptr if there was no customization yet.
+     */
+    [[nodiscard]] auto metric() const -> std::shared_ptr<const Metric> {
+        return std::atomic_load(&m_metric);
+    }
+
+    /**
+     * Whether weights were applied, so that queries can run.
+     */
+    [[nodiscard]] bool customized() const { return metric() != nullptr; }
+
+    /**
+     * Point-to-point query: upward searches from both ends along their paths up the
+     * elimination tree, meeting at the common ancestor of the shortest path. Requires
+     * customized().
+     *
+     * @return Distance and the unpacked path, INF and an empty path if t is unreachable.
+     */
+    auto query(Index s, Index t) const -> std::pair<Distance, Graph::Route>;
+
+    /**
+     * Many-to-many distance table by the bucket technique, like Hierarchy::many_to_many(),
+     * on the given metric so that the rows computed separately are consistent.
+     */
+    auto many_to_many(const std::vector<Index>& sources, const std::vector<Index>& targets,
+                      const Metric& metric) const -> std::vector<ShortestPaths>;
+
+private:
+    /**
+     * Search from s along its path up the elimination tree: no queue is needed, as nodes
+     * on it come in the order of rank. Calls settle(node, distance) for each reached one.
+     * Distances (INF outside of a search) and arcs hold the labels until clear().
+     */
+    template<typename F>
+    void upward(Index s, const std::vector<Distance>& weights, ShortestPaths& distances,
+                std::vector<Index>& arcs, F&& settle) const;
+    void clear(Index s, ShortestPaths& distances) const;
+
+    /**
+     * Improve the arcs to the higher neighbours of a node through its lower triangles.
+     */
+    void triangles(Index x, Metric& metric) const;
+
+    /**
+     * Arc between two nodes, the first one lower ranked; NONE if there is none.
+     */
+    [[nodiscard]] Index arc(Index lower, Index higher) const;
+
+    /**
+     * Append nodes of an arc traversed up or down to the route, excluding its start.
+     */
+    void unpack(const Metric& metric, Index arc, bool up, Graph::Route& route) const;
+
+    std::uint64_t m_fingerprint = 0;
+    std::vector<Index> m_rank {};
+    std::vector<Index> m_parent {};
+    /**
+     * Arcs to the higher neighbours of each node in CSR layout, sorted by rank; an arc is
+     * identified by its position.
+     */
+    std::vector<Index> m_offsets { 0 };
+    std::vector<Index> m_heads {};
+    std::vector<Index> m_tails {};
+    /**
+     * Arcs from the lower neighbours of each node in CSR layout.
+     */
+    std::vector<Index> m_lower_offsets { 0 };
+    std::vector<Index> m_lower {};
+    /**
+     * Nodes by level in the elimination tree, counted from the leaves, in CSR layout.
+     */
+    std::vector<Index> m_level_offsets { 0 };
+    std::vector<Index> m_levels {};
+    /**
+     * Arc of each edge of the graph shifted left, the lowest bit set if the edge leads
+     * down; NONE for loops.
+     */
+    std::vector<Index> m_edges {};
+    std::shared_ptr<const Metric> m_metric {};
+};
+} // namespace graphs
+
+#endif // GRAPHS_CUSTOMIZABLE_HPP
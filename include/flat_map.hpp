@@ -0,0 +1,344 @@
+#ifndef GRAPHS_FLAT_MAP_HPP
+#define GRAPHS_FLAT_MAP_HPP
+
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace graphs {
+/**
+ * Finalizer of MurmurHash3: spreads the bits of an identifier over the whole word, so that
+ * sequential OSM ids land in different groups.
+ */
+inline std::uint64_t mix(std::uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/**
+ * Hash by identifier only: integers by their value, Nodes and Buildings by their OSM id,
+ * pairs by both parts. Equality of these types is defined by the id, so nothing else needs
+ * to be read.
+ */
+template<typename Key, typename = void>
+struct IdHash {
+    std::size_t operator()(const Key& key) const { return mix(static_cast<std::uint64_t>(key)); }
+};
+
+template<typename Key>
+struct IdHash<Key, std::void_t<decltype(std::declval<const Key&>().id())>> {
+    std::size_t operator()(const Key& key) const { return mix(key.id()); }
+};
+
+template<typename First, typename Second>
+struct IdHash<std::pair<First, Second>> {
+    std::size_t operator()(const std::pair<First, Second>& key) const {
+        return mix(IdHash<First> {}(key.first) ^ (IdHash<Second> {}(key.second) >> 1));
+    }
+};
+
+/**
+ * Hash map with open addressing in one flat array of slots.
+ *
+ * Every slot has a control byte: empty, deleted, or the low 7 bits of the hash of its key.
+ * Slots are probed in groups of GROUP along a triangular sequence of groups; a group is
+ * matched against the hash bits with one SSE2 comparison, so keys are only compared for
+ * the few slots whose bits agree, and a group with an empty slot ends the search. The
+ * table grows past 7/8 of its capacity; erased slots are marked deleted and dropped on
+ * the next growth. Elements are constructed in place in the slots, so keys stay const.
+ *
+ * Unlike std::unordered_map, inserting may move the elements and invalidates iterators.
+ */
+template<typename Key, typename Value, typename Hash = IdHash<Key>,
+         typename Equal = std::equal_to<Key>>
+struct FlatMap {
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = std::pair<const Key, Value>;
+
+    static constexpr std::size_t GROUP = 16;
+
+    template<typename Map, typename Reference>
+    struct Iterator {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = FlatMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::remove_reference_t<Reference>*;
+        using reference = Reference;
+
+        reference operator*() const { return m_map->element(m_index); }
+        pointer operator->() const { return &m_map->element(m_index); }
+        Iterator& operator++() {
+            m_index = m_map->next(m_index + 1);
+            return *this;
+        }
+        bool operator==(const Iterator& other) const { return m_index == other.m_index; }
+        bool operator!=(const Iterator& other) const { return m_index != other.m_index; }
+
+        Map* m_map;
+        std::size_t m_index;
+    };
+
+    using iterator = Iterator<FlatMap, value_type&>;
+    using const_iterator = Iterator<const FlatMap, const value_type&>;
+
+    FlatMap() = default;
+    explicit FlatMap(std::size_t count) { reserve(count); }
+
+    FlatMap(const FlatMap& other)
+        : m_control(other.m_control)
+        , m_slots(std::make_unique<Slot[]>(other.capacity()))
+        , m_size(other.m_size)
+        , m_deleted(other.m_deleted)
+        , m_hash(other.m_hash)
+        , m_equal(other.m_equal) {
+        for (std::size_t i = 0; i < capacity(); i += 1) {
+            if (m_control[i] >= 0) { ::new (&m_slots[i]) value_type(other.element(i)); }
+        }
+    }
+    FlatMap(FlatMap&& other) noexcept
+        : m_control(std::move(other.m_control))
+        , m_slots(std::move(other.m_slots))
+        , m_size(std::exchange(other.m_size, 0))
+        , m_deleted(std::exchange(other.m_deleted, 0))
+        , m_hash(std::move(other.m_hash))
+        , m_equal(std::move(other.m_equal)) {}
+    FlatMap& operator=(FlatMap other) noexcept {
+        swap(other);
+        return *this;
+    }
+    ~FlatMap() { destroy(); }
+
+    void swap(FlatMap& other) noexcept {
+        std::swap(m_control, other.m_control);
+        std::swap(m_slots, other.m_slots);
+        std::swap(m_size, other.m_size);
+        std::swap(m_deleted, other.m_deleted);
+        std::swap(m_hash, other.m_hash);
+        std::swap(m_equal, other.m_equal);
+    }
+
+    [[nodiscard]] std::size_t size() const { return m_size; }
+    [[nodiscard]] bool empty() const { return m_size == 0; }
+    [[nodiscard]] std::size_t capacity() const { return m_control.size(); }
+
+    iterator begin() { return { this, next(0) }; }
+    iterator end() { return { this, capacity() }; }
+    const_iterator begin() const { return { this, next(0) }; }
+    const_iterator end() const { return { this, capacity() }; }
+
+    /**
+     * Make room for count elements, so that inserting them does not rehash.
+     */
+    void reserve(std::size_t count) {
+        if (count > capacity() / 8 * 7) { rehash(capacity_for(count)); }
+    }
+
+    void clear() {
+        destroy();
+        std::fill(m_control.begin(), m_control.end(), EMPTY);
+        m_size = 0, m_deleted = 0;
+    }
+
+    iterator find(const Key& key) { return { this, locate(key, m_hash(key)) }; }
+    const_iterator find(const Key& key) const { return { this, locate(key, m_hash(key)) }; }
+    [[nodiscard]] std::size_t count(const Key& key) const { return find(key) != end(); }
+    [[nodiscard]] bool contains(const Key& key) const { return find(key) != end(); }
+
+    Value& at(const Key& key) {
+        const auto i = locate(key, m_hash(key));
+        if (i == capacity()) { throw std::out_of_range { "FlatMap::at" }; }
+        return element(i).second;
+    }
+    const Value& at(const Key& key) const {
+        const auto i = locate(key, m_hash(key));
+        if (i == capacity()) { throw std::out_of_range { "FlatMap::at" }; }
+        return element(i).second;
+    }
+    Value& operator[](const Key& key) { return try_emplace(key).first->second; }
+
+    /**
+     * Insert the value constructed from args unless the key is present.
+     *
+     * @return Element of the key and whether it was inserted.
+     */
+    template<typename... Args>
+    auto try_emplace(const Key& key, Args&& ... args) -> std::pair<iterator, bool> {
+        const auto hash = m_hash(key);
+        if (const auto i = locate(key, hash); i != capacity()) { return {{ this, i }, false }; }
+        if (m_size + m_deleted + 1 > capacity() / 8 * 7) {
+            // Doubles the table, or only drops the deleted slots if they took the room.
+            rehash(capacity_for(2 * (m_size + 1)));
+        }
+        const auto i = vacant(hash);
+        ::new (&m_slots[i]) value_type(std::piecewise_construct, std::forward_as_tuple(key),
+                                       std::forward_as_tuple(std::forward<Args>(args)...));
+        m_deleted -= m_control[i] == DELETED;
+        m_control[i] = tag(hash);
+        m_size += 1;
+        return {{ this, i }, true };
+    }
+    template<typename... Args>
+    auto emplace(const Key& key, Args&& ... args) -> std::pair<iterator, bool> {
+        return try_emplace(key, std::forward<Args>(args)...);
+    }
+    auto insert(const value_type& value) -> std::pair<iterator, bool> {
+        return try_emplace(value.first, value.second);
+    }
+
+    iterator erase(iterator it) {
+        std::destroy_at(&element(it.m_index));
+        m_control[it.m_index] = DELETED;
+        m_size -= 1, m_deleted += 1;
+        return { this, next(it.m_index + 1) };
+    }
+    std::size_t erase(const Key& key) {
+        const auto it = find(key);
+        if (it == end()) { return 0; }
+        erase(it);
+        return 1;
+    }
+
+private:
+    static constexpr std::int8_t EMPTY = -128;
+    static constexpr std::int8_t DELETED = -2;
+
+    /**
+     * Room for one element, which lives there while the control byte of the slot is full.
+     */
+    struct Slot {
+        alignas(value_type) unsigned char bytes[sizeof(value_type)];
+    };
+
+    value_type& element(std::size_t i) {
+        return *std::launder(reinterpret_cast<value_type*>(&m_slots[i]));
+    }
+    const value_type& element(std::size_t i) const {
+        return *std::launder(reinterpret_cast<const value_type*>(&m_slots[i]));
+    }
+
+    void destroy() {
+        for (std::size_t i = 0; i < capacity(); i += 1) {
+            if (m_control[i] >= 0) { std::destroy_at(&element(i)); }
+        }
+    }
+
+    /**
+     * Control byte of a full slot: low 7 bits of the hash, the high ones pick the group.
+     */
+    static std::int8_t tag(std::size_t hash) { return static_cast<std::int8_t>(hash & 0x7f); }
+
+    static std::size_t capacity_for(std::size_t count) {
+        std::size_t result = GROUP;
+        while (count > result / 8 * 7) { result *= 2; }
+        return result;
+    }
+
+    /**
+     * Slots of the group starting at base whose control byte equals the given one, as bits.
+     */
+    [[nodiscard]] std::uint32_t match(std::size_t base, std::int8_t control) const {
+#ifdef __SSE2__
+        const auto group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_control[base]));
+        return static_cast<std::uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(control))));
+#else
+        std::uint32_t result = 0;
+        for (std::size_t i = 0; i < GROUP; i += 1) {
+            result |= std::uint32_t { m_control[base + i] == control } << i;
+        }
+        return result;
+#endif
+    }
+
+    /**
+     * Slots of the group that are empty or deleted: their control bytes are negative.
+     */
+    [[nodiscard]] std::uint32_t match_vacant(std::size_t base) const {
+#ifdef __SSE2__
+        const auto group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_control[base]));
+        return static_cast<std::uint32_t>(_mm_movemask_epi8(group));
+#else
+        std::uint32_t result = 0;
+        for (std::size_t i = 0; i < GROUP; i += 1) {
+            result |= std::uint32_t { m_control[base + i] < 0 } << i;
+        }
+        return result;
+#endif
+    }
+
+    /**
+     * Slot of the key, capacity() if it is absent.
+     */
+    [[nodiscard]] std::size_t locate(const Key& key, std::size_t hash) const {
+        if (m_size == 0) { return capacity(); }
+        const auto mask = capacity() / GROUP - 1;
+        auto group = (hash >> 7) & mask;
+        for (std::size_t step = 1;; group = (group + step++) & mask) {
+            const auto base = group * GROUP;
+            for (auto bits = match(base, tag(hash)); bits != 0; bits &= bits - 1) {
+                const auto i = base + __builtin_ctz(bits);
+                if (m_equal(element(i).first, key)) { return i; }
+            }
+            if (match(base, EMPTY) != 0) { return capacity(); }
+        }
+    }
+
+    /**
+     * First empty or deleted slot on the probe sequence of the hash.
+     */
+    [[nodiscard]] std::size_t vacant(std::size_t hash) const {
+        const auto mask = capacity() / GROUP - 1;
+        auto group = (hash >> 7) & mask;
+        for (std::size_t step = 1;; group = (group + step++) & mask) {
+            if (const auto bits = match_vacant(group * GROUP); bits != 0) {
+                return group * GROUP + __builtin_ctz(bits);
+            }
+        }
+    }
+
+    [[nodiscard]] std::size_t next(std::size_t i) const {
+        while (i < capacity() && m_control[i] < 0) { i += 1; }
+        return i;
+    }
+
+    void rehash(std::size_t capacity) {
+        const auto control = std::exchange(m_control, std::vector<std::int8_t>(capacity, EMPTY));
+        const auto slots = std::exchange(m_slots, std::make_unique<Slot[]>(capacity));
+        m_deleted = 0;
+        for (std::size_t i = 0; i < control.size(); i += 1) {
+            if (control[i] < 0) { continue; }
+            auto& element = *std::launder(reinterpret_cast<value_type*>(&slots[i]));
+            const auto hash = m_hash(element.first);
+            const auto j = vacant(hash);
+            ::new (&m_slots[j]) value_type(std::move(element));
+            std::destroy_at(&element);
+            m_control[j] = tag(hash);
+        }
+    }
+
+    std::vector<std::int8_t> m_control {};
+    std::unique_ptr<Slot[]> m_slots {};
+    std::size_t m_size = 0;
+    std::size_t m_deleted = 0;
+    Hash m_hash {};
+    Equal m_equal {};
+};
+} // namespace graphs
+
+#endif // GRAPHS_FLAT_MAP_HPP
@@ -35,6 +35,14 @@ struct LineString: Json {
     explicit LineString(const Locations& locs, Color color = Color::gray);
 };
 
+/**
+ * Filled polygon from an open ring, the first location is repeated to close it.
+ */
+struct Polygon: Json {
+    Polygon() = delete;
+    explicit Polygon(const Locations& ring, Color color = Color::gray);
+};
+
 Point building_to_point(const Building& building, Color color = Color::gray);
 Features buildings_to_features(const Buildings& buildings, Color color = Color::gray);
 
@@ -45,6 +53,12 @@ Features paths_and_buildings_to_features(const Map::TracedPaths& paths,
                                          const Buildings& buildings,
                                          Color color = Color::gray);
 
+/**
+ * Edges of the band and the outline of the isochrone.
+ */
+Features isochrone_to_features(const Map::Isochrone& isochrone, Color color = Color::gray);
+Features isochrones_to_features(const Map::Isochrones& isochrones, Colors colors = Colors());
+
 Features map_to_features(const Map& map, Color color = Color::gray);
 FeatureCollection map_to_geojson(const Map& map, Color color = Color::gray);
 
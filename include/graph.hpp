@@ -1,39 +1,299 @@
 #ifndef GRAPH_HPP
 #define GRAPH_HPP
 
+#include <iterator>
+#include <limits>
+
 #include "node.hpp"
+#include "heap.hpp"
+#include "workspace.hpp"
+#include "flat_map.hpp"
 
 namespace fs = std::filesystem;
 
 namespace graphs {
+struct Scheduler;
+
 /**
- * Type for representing shortest paths from one Node to others.
+ * Type for representing shortest paths from one Node to others, indexed by Graph::Index.
  */
-using ShortestPaths = std::unordered_map<Node, Distance>;
+using ShortestPaths = std::vector<Distance>;
 
 /**
- * Undirected weighted routing graph implemented as an adjacency list.
+ * Directed weighted routing graph.
+ *
+ * Each node gets a contiguous index on insertion; its OSM id and location are kept in
+ * a side table of plain arrays indexed by that number, like all other per-node state.
+ *
+ * Edges are collected into an adjacency list and then frozen into a compressed sparse row
+ * layout: outgoing edges of the i-th node occupy [offsets[i], offsets[i + 1]) of the packed
+ * targets and weights arrays. Searches run on the frozen layout only.
  */
 struct Graph {
+    using Index = std::uint32_t;
+    /**
+     * Predecessor of each node in the shortest paths tree, NONE for the root and unreached.
+     */
+    using Trail = std::vector<Index>;
+    /**
+     * Node indices of a path from its source to its target.
+     */
+    using Route = std::vector<Index>;
+
 private:
     using Edge = std::pair<Node, Node>;
-    using OutgoingEdges = std::unordered_map<Node, Distance>;
-    using AdjacencyList = std::unordered_map<Node, OutgoingEdges>;
-    using Trail = std::unordered_map<Node, Node>;
+    using OutgoingEdges = std::vector<std::pair<Index, Distance>>;
+    using AdjacencyList = std::vector<OutgoingEdges>;
 
 public:
+    /**
+     * Outgoing edges of a frozen node as (target index, weight) pairs.
+     */
+    struct Edges {
+        struct Iterator {
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::pair<Index, Distance>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = value_type;
+
+            value_type operator*() const { return { *m_target, *m_weight }; }
+            Iterator& operator++() {
+                ++m_target, ++m_weight;
+                return *this;
+            }
+            bool operator==(const Iterator& other) const { return m_target == other.m_target; }
+            bool operator!=(const Iterator& other) const { return m_target != other.m_target; }
+
+            const Index* m_target;
+            const Distance* m_weight;
+        };
+
+        [[nodiscard]] Iterator begin() const { return m_begin; }
+        [[nodiscard]] Iterator end() const { return m_end; }
+        [[nodiscard]] std::size_t size() const { return m_end.m_target - m_begin.m_target; }
+
+        Iterator m_begin, m_end;
+    };
+
+    static constexpr Distance INF = std::numeric_limits<Distance>::max();
+    static constexpr Index NONE = std::numeric_limits<Index>::max();
+
+    /**
+     * Sources advanced together by batched_dijkstra(), one lane of the labels each.
+     */
+    static constexpr std::size_t LANES = 8;
+    /**
+     * Default key bucket of batched_dijkstra(), in mean edge weights.
+     */
+    static constexpr Distance BUCKET = 3;
+
+    /**
+     * Searches run along the edges (forward) or against them (backward), the latter
+     * measuring distances from the reached nodes to the root.
+     */
+    enum class Direction {
+        Forward,
+        Backward
+    };
+
+    /**
+     * Make room for the given number of nodes, so that adding them does not rehash the index.
+     */
+    void reserve(std::size_t nodes);
+
     bool add_edge_one_way(Edge&& e, Distance d = 0) noexcept;
     bool add_edge_two_way(Edge&& e, Distance d = 0) noexcept;
 
+    /**
+     * Pack the adjacency list into the CSR layout and release it.
+     * The reverse adjacency for searches against edge direction is packed the same way.
+     * Adding an edge to a frozen graph thaws it back.
+     */
+    void freeze();
+    [[nodiscard]] bool frozen() const { return m_frozen; }
+
     bool serialize(const fs::path& filename) const;
     bool deserialize(const fs::path& filename);
 
-    const auto& nodes() const { return m_data; }
+    [[nodiscard]] std::size_t size() const { return m_nodes.size(); }
+    [[nodiscard]] std::size_t edges_count() const { return m_targets.size(); }
+
+    /**
+     * Checksum of the ids and the edges, dumps of the structures derived from the graph
+     * carry it to be rejected when the graph changes.
+     */
+    [[nodiscard]] std::uint64_t fingerprint() const;
+
+    /**
+     * Ids and coordinates of the nodes, apart from the topology that refers to them by index.
+     */
+    const auto& nodes() const { return m_nodes; }
+    const auto& weights() const { return m_weights; }
+    Node node(Index i) const { return m_nodes[i]; }
+    auto index(const Node& node) const -> Index { return m_index.at(node.id()); }
+    bool contains(const Node& node) const { return m_index.count(node.id()) != 0; }
+    auto edges(Index v) const -> Edges {
+        return {{ m_targets.data() + m_offsets[v], m_weights.data() + m_offsets[v] },
+                { m_targets.data() + m_offsets[v + 1], m_weights.data() + m_offsets[v + 1] }};
+    }
+    /**
+     * Incoming edges of a frozen node as (source index, weight) pairs.
+     */
+    auto incoming(Index v) const -> Edges {
+        return {{ m_sources.data() + m_reverse_offsets[v],
+                  m_reverse_weights.data() + m_reverse_offsets[v] },
+                { m_sources.data() + m_reverse_offsets[v + 1],
+                  m_reverse_weights.data() + m_reverse_offsets[v + 1] }};
+    }
+
+    /**
+     * Weight of the edge between two nodes, INF if there is none.
+     */
+    auto weight(Index from, Index to) const -> Distance;
 
-    auto dijkstra(Node s) const -> std::pair<ShortestPaths, Trail>;
+    /**
+     * Single-source shortest paths.
+     *
+     * Search stops as soon as every target is settled; distances of the nodes left in
+     * the queue are then upper bounds only. Nodes further than the cutoff are never
+     * reached and keep INF.
+     *
+     * @tparam Queue Priority queue policy from heap.hpp.
+     * @param targets Nodes to settle, empty for all.
+     * @param cutoff Maximal distance of interest.
+     */
+    template<typename Queue = QuaternaryHeap>
+    auto dijkstra(Index s, const std::vector<Index>& targets = {}, Distance cutoff = INF) const
+    -> std::pair<ShortestPaths, Trail>;
+
+    /**
+     * Same search in a reusable workspace, which is reset first and holds the result after.
+     * Repeated queries neither allocate nor touch the nodes they do not reach.
+     */
+    template<typename Queue = QuaternaryHeap>
+    void dijkstra(Index s, Workspace<Queue>& workspace, const std::vector<Index>& targets = {},
+                  Distance cutoff = INF) const;
+
+    /**
+     * Backward single-target search over the reverse adjacency: distances from every node
+     * (or the given sources) to t, the trail holds the next node on the way to t.
+     * One reverse search replaces a forward one from each of the sources.
+     */
+    auto reverse_dijkstra(Index t, const std::vector<Index>& sources = {},
+                          Distance cutoff = INF) const -> std::pair<ShortestPaths, Trail>;
+    void reverse_dijkstra(Index t, Workspace<>& workspace, const std::vector<Index>& sources = {},
+                          Distance cutoff = INF) const;
+
+    /**
+     * Radius-bounded search: nodes no further than the radius from s, in the order of distance.
+     * Nothing past the radius is queued, so the cost follows the size of the neighbourhood.
+     */
+    auto within(Index s, Distance radius, Workspace<>& workspace,
+                Direction direction = Direction::Forward) const
+    -> std::vector<std::pair<Index, Distance>>;
+
+    /**
+     * Multi-source search (network Voronoi partition): every node gets the closest of the
+     * sources and the distance to it in one pass. Ties go to the earlier source.
+     *
+     * @param direction Backward search measures distances from nodes to the sources.
+     * @return Distances and positions in sources of the closest ones, NONE if unreachable.
+     */
+    auto voronoi(const std::vector<Index>& sources, Direction direction = Direction::Forward) const
+    -> std::pair<ShortestPaths, std::vector<Index>>;
+
+    /**
+     * Shortest paths from several sources at once, LANES of them per search.
+     *
+     * Every node holds a distance per source, interleaved, and is queued by the smallest
+     * of its improved distances. A popped node relaxes each edge for all sources with vector
+     * min operations, so an edge is read from memory once for the whole batch. Keys are
+     * rounded down to buckets of width delta: lanes improving a node within one bucket share
+     * its scan, at the price of scanning a node again if it improves after that. Sources are
+     * batched in Z-order of their locations, so the search fronts of a batch stay close.
+     *
+     * @param delta Bucket width, 0 picks BUCKET mean edge weights.
+     * @return Distances from each of the sources to every node.
+     */
+    auto batched_dijkstra(const std::vector<Index>& sources, Distance delta = 0) const
+    -> std::vector<ShortestPaths>;
+
+    /**
+     * Positions in nodes sorted along a Z-order curve over their locations, so that
+     * consecutive ones are close to each other. Cut into LANES it gives the batches
+     * batched_dijkstra() searches.
+     */
+    auto z_order(const std::vector<Index>& nodes) const -> std::vector<std::size_t>;
+
+    /**
+     * Single-source shortest paths to every node by parallel delta-stepping.
+     *
+     * Tentative distances are kept in buckets of width delta. Light edges (not longer than
+     * delta) of the lowest bucket are relaxed in parallel until it stays empty, then heavy
+     * edges of all nodes it settled are relaxed once. Result matches dijkstra() up to ties
+     * in the trail.
+     *
+     * @param scheduler Workers to relax the edges on.
+     * @param delta Bucket width, 0 picks the mean edge weight.
+     */
+    auto delta_stepping(Index s, Scheduler& scheduler, Distance delta = 0) const
+    -> std::pair<ShortestPaths, Trail>;
+
+    /**
+     * Point-to-point shortest path by bidirectional Dijkstra.
+     * Forward search runs on the outgoing edges and backward one on the incoming,
+     * both stop once the sum of their queue minima reaches the best path seen.
+     *
+     * @return Distance and the path, INF and an empty path if t is unreachable.
+     */
+    auto bidirectional(Index s, Index t) const -> std::pair<Distance, Route>;
+
+    /**
+     * Goal-directed search (A*) towards one or several targets.
+     * Nodes are extracted in the order of distance plus potential, so with a tight
+     * lower bound only a corridor towards the targets is settled. Stops once every
+     * target is settled; only their distances and trails are final.
+     *
+     * @tparam Potential Lower bound of the distance to the closest target, see potential.hpp
+     *                   and landmarks.hpp.
+     * @param cutoff Maximal distance of interest; nodes whose distance plus potential exceeds
+     *               it are never queued, so targets further than it keep INF.
+     */
+    template<typename Potential>
+    auto astar(Index s, const std::vector<Index>& targets, const Potential& potential,
+               Distance cutoff = INF) const -> std::pair<ShortestPaths, Trail>;
 
 private:
+    template<typename Queue>
+    void search(Index s, Workspace<Queue>& workspace, const std::vector<Index>& targets,
+                Distance cutoff, Direction direction) const;
+
+    /**
+     * Edges of a node in the direction of a search.
+     */
+    auto edges(Index v, Direction direction) const -> Edges {
+        return direction == Direction::Forward ? edges(v) : incoming(v);
+    }
+
+    [[nodiscard]] Distance mean_weight() const;
+
+    auto intern(const Node& node) -> Index;
+    void thaw();
+    void transpose();
+
+    bool m_frozen = true;
     AdjacencyList m_data {};
+
+    NodeStore m_nodes {};
+    FlatMap<std::uint64_t, Index> m_index {};
+    std::vector<Index> m_offsets { 0 };
+    std::vector<Index> m_targets {};
+    std::vector<Distance> m_weights {};
+
+    std::vector<Index> m_reverse_offsets { 0 };
+    std::vector<Index> m_sources {};
+    std::vector<Distance> m_reverse_weights {};
 };
 } // namespace graph
 
@@ -0,0 +1,208 @@
+#ifndef GRAPHS_HEAP_HPP
+#define GRAPHS_HEAP_HPP
+
+#include <array>
+#include <queue>
+#include <vector>
+#include <limits>
+#include <functional>
+
+#include "utils.hpp"
+
+/*
+ * Priority queue policies for the shortest paths searches.
+ *
+ * Every policy is constructed with the number of nodes and exposes:
+ *   push(v, key) -- insert node or decrease its key;
+ *   pop()        -- extract (key, node) with the minimal key;
+ *   clear()      -- drop the remaining entries of a search stopped early;
+ *   empty().
+ * Lazy policies may return outdated entries, so callers skip a popped node whose key
+ * is greater than its current distance.
+ */
+namespace graphs {
+/**
+ * Indexed D-ary heap with real decrease-key.
+ * Positions of nodes are tracked in an array, so each node is stored at most once.
+ */
+template<unsigned D>
+struct DAryHeap {
+    using Index = std::uint32_t;
+
+    explicit DAryHeap(std::size_t n)
+        : m_position(n, NONE) {}
+
+    [[nodiscard]] bool empty() const { return m_heap.empty(); }
+    [[nodiscard]] Distance top() const { return m_heap.front().first; }
+
+    void push(Index v, Distance key) {
+        if (m_position[v] == NONE) {
+            m_position[v] = m_heap.size();
+            m_heap.emplace_back(key, v);
+        } else {
+            m_heap[m_position[v]].first = key;
+        }
+        sift_up(m_position[v]);
+    }
+
+    void clear() {
+        for (const auto&[_, v]: m_heap) { m_position[v] = NONE; }
+        m_heap.clear();
+    }
+
+    auto pop() -> std::pair<Distance, Index> {
+        const auto top = m_heap.front();
+        m_position[top.second] = NONE;
+        if (m_heap.size() > 1) {
+            m_heap.front() = m_heap.back();
+            m_position[m_heap.front().second] = 0;
+            m_heap.pop_back();
+            sift_down(0);
+        } else {
+            m_heap.pop_back();
+        }
+        return top;
+    }
+
+private:
+    static constexpr Index NONE = std::numeric_limits<Index>::max();
+
+    void sift_up(Index i) {
+        const auto item = m_heap[i];
+        while (i > 0) {
+            const auto parent = (i - 1) / D;
+            if (m_heap[parent].first <= item.first) { break; }
+            place(i, m_heap[parent]);
+            i = parent;
+        }
+        place(i, item);
+    }
+
+    void sift_down(Index i) {
+        const auto item = m_heap[i];
+        const auto size = m_heap.size();
+        while (true) {
+            const auto first = static_cast<std::size_t>(i) * D + 1;
+            if (first >= size) { break; }
+            const auto last = std::min<std::size_t>(first + D, size);
+            auto best = first;
+            for (auto c = first + 1; c < last; c += 1) {
+                if (m_heap[c].first < m_heap[best].first) { best = c; }
+            }
+            if (item.first <= m_heap[best].first) { break; }
+            place(i, m_heap[best]);
+            i = best;
+        }
+        place(i, item);
+    }
+
+    void place(Index i, const std::pair<Distance, Index>& item) {
+        m_heap[i] = item;
+        m_position[item.second] = i;
+    }
+
+    std::vector<std::pair<Distance, Index>> m_heap {};
+    std::vector<Index> m_position;
+};
+
+using QuaternaryHeap = DAryHeap<4>;
+
+/**
+ * Binary heap without decrease-key: improved nodes are pushed again
+ * and their outdated entries are skipped by the search.
+ */
+struct LazyBinaryHeap {
+    using Index = std::uint32_t;
+
+    explicit LazyBinaryHeap(std::size_t) {}
+
+    [[nodiscard]] bool empty() const { return m_heap.empty(); }
+
+    void push(Index v, Distance key) { m_heap.emplace(key, v); }
+
+    void clear() { m_heap = {}; }
+
+    auto pop() -> std::pair<Distance, Index> {
+        auto top = m_heap.top();
+        m_heap.pop();
+        return top;
+    }
+
+private:
+    using Item = std::pair<Distance, Index>;
+
+    std::priority_queue<Item, std::vector<Item>, std::greater<>> m_heap {};
+};
+
+/**
+ * Monotone radix heap over keys quantized to QUANTUM meters.
+ *
+ * Item with key k lives in the bucket of the highest bit in which k differs from the last
+ * extracted key, so each item moves to a lower bucket at most 64 times. Requires that pushed
+ * keys never go below the last extracted one, which holds for Dijkstra with non-negative
+ * weights. Items that share a quantum are extracted in arbitrary order; the search settles
+ * such a node again if its distance improves afterwards, so the result stays exact. A search
+ * stopped at its targets may leave them off by less than QUANTUM.
+ */
+struct RadixHeap {
+    using Index = std::uint32_t;
+
+    static constexpr Distance QUANTUM = 0.01;
+
+    explicit RadixHeap(std::size_t) {}
+
+    [[nodiscard]] bool empty() const { return m_size == 0; }
+
+    void push(Index v, Distance key) {
+        const auto quantized = quantize(key);
+        m_buckets[bucket(quantized)].push_back({ quantized, key, v });
+        m_size += 1;
+    }
+
+    void clear() {
+        for (auto& bucket: m_buckets) { bucket.clear(); }
+        m_last = 0, m_size = 0;
+    }
+
+    auto pop() -> std::pair<Distance, Index> {
+        if (m_buckets[0].empty()) { redistribute(); }
+        const auto item = m_buckets[0].back();
+        m_buckets[0].pop_back();
+        m_size -= 1;
+        return { item.key, item.node };
+    }
+
+private:
+    struct Item {
+        std::uint64_t quantized;
+        Distance key;
+        Index node;
+    };
+
+    static std::uint64_t quantize(Distance key) {
+        return static_cast<std::uint64_t>(key / QUANTUM);
+    }
+
+    [[nodiscard]] std::size_t bucket(std::uint64_t quantized) const {
+        const auto diff = quantized ^ m_last;
+        return diff == 0 ? 0 : 64 - __builtin_clzll(diff);
+    }
+
+    void redistribute() {
+        auto i = std::size_t { 1 };
+        while (m_buckets[i].empty()) { i += 1; }
+
+        auto& source = m_buckets[i];
+        m_last = source.front().quantized;
+        for (const auto& item: source) { m_last = std::min(m_last, item.quantized); }
+        for (const auto& item: source) { m_buckets[bucket(item.quantized)].push_back(item); }
+        source.clear();
+    }
+
+    std::array<std::vector<Item>, 65> m_buckets {};
+    std::uint64_t m_last = 0;
+    std::size_t m_size = 0;
+};
+} // namespace graphs
+
+#endif // GRAPHS_HEAP_HPP
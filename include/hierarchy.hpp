@@ -0,0 +1,161 @@
+#ifndef GRAPHS_HIERARCHY_HPP
+#define GRAPHS_HIERARCHY_HPP
+
+#include <boost/serialization/access.hpp>
+
+#include "graph.hpp"
+
+namespace fs = std::filesystem;
+
+namespace graphs {
+/**
+ * Contraction Hierarchy over a frozen Graph.
+ *
+ * Nodes are contracted one by one in the order of their edge difference (number of added
+ * shortcuts minus number of removed edges), balanced by how deep into the hierarchy they
+ * would go. Contracting a node adds a shortcut between each
+ * pair of its neighbours unless a witness search finds a path of the same length around it.
+ * Every shortest path then has an equivalent one going first up and then down the ranks.
+ *
+ * Arcs of the hierarchy are original edges and shortcuts; a shortcut refers to the two arcs
+ * it replaces, so paths could be unpacked back to the original nodes.
+ */
+struct Hierarchy {
+    using Index = Graph::Index;
+
+    /**
+     * Original edge or shortcut spanning two arcs.
+     */
+    struct Arc {
+        Index from = 0, to = 0;
+        Distance weight = 0;
+        Index first = Graph::NONE, second = Graph::NONE;
+
+        [[nodiscard]] bool shortcut() const { return first != Graph::NONE; }
+
+        friend class boost::serialization::access;
+        template<typename Archive>
+        void serialize(Archive& archive, const unsigned int& version) {
+            (void) version;
+            archive & from & to & weight & first & second;
+        }
+    };
+
+    /**
+     * Search graph in CSR layout: for each node, (neighbour, weight, arc) triples.
+     */
+    struct Adjacency {
+        struct Entry {
+            Index node;
+            Distance weight;
+            Index arc;
+
+            template<typename Archive>
+            void serialize(Archive& archive, const unsigned int& version) {
+                (void) version;
+                archive & node & weight & arc;
+            }
+        };
+
+        struct Row {
+            [[nodiscard]] const Entry* begin() const { return m_begin; }
+            [[nodiscard]] const Entry* end() const { return m_end; }
+
+            const Entry* m_begin;
+            const Entry* m_end;
+        };
+
+        [[nodiscard]] Row operator[](Index v) const {
+            return { m_entries.data() + m_offsets[v], m_entries.data() + m_offsets[v + 1] };
+        }
+
+        friend class boost::serialization::access;
+        template<typename Archive>
+        void serialize(Archive& archive, const unsigned int& version) {
+            (void) version;
+            archive & m_offsets & m_entries;
+        }
+
+        std::vector<Index> m_offsets { 0 };
+        std::vector<Entry> m_entries {};
+    };
+
+    Hierarchy() = default;
+
+    /**
+     * Contract the graph.
+     */
+    explicit Hierarchy(const Graph& graph);
+
+    bool serialize(const fs::path& filename) const;
+    /**
+     * Load the dump of the graph with the given Graph::fingerprint, false if it is missing
+     * or was built from another graph.
+     */
+    bool deserialize(const fs::path& filename, std::uint64_t fingerprint);
+
+    [[nodiscard]] bool empty() const { return m_rank.empty(); }
+    [[nodiscard]] std::size_t size() const { return m_rank.size(); }
+    [[nodiscard]] std::size_t arcs_count() const { return m_arcs.size(); }
+    [[nodiscard]] std::uint64_t fingerprint() const { return m_fingerprint; }
+
+    /**
+     * Position of the node in the contraction order.
+     */
+    [[nodiscard]] Index rank(Index v) const { return m_rank[v]; }
+
+    /**
+     * Arcs leading from a node to the higher ranked ones.
+     */
+    const auto& up() const { return m_up; }
+
+    /**
+     * Arcs leading to a node from the higher ranked ones, stored at their heads,
+     * so that a backward search from the target walks up the ranks too.
+     */
+    const auto& down() const { return m_down; }
+
+    /**
+     * Point-to-point query: two upward Dijkstra searches meeting at the highest node
+     * of the shortest path. Each one stops when its queue minimum reaches the best
+     * distance found.
+     *
+     * @return Distance and the unpacked path, INF and an empty path if t is unreachable.
+     */
+    auto query(Index s, Index t) const -> std::pair<Distance, Graph::Route>;
+
+    /**
+     * Many-to-many distance table by the bucket technique.
+     * Backward upward search from each target leaves (target, distance) entries in buckets
+     * of the nodes it settles; forward upward search from each source then scans buckets of
+     * its settled nodes, so the table costs |sources| + |targets| small searches.
+     *
+     * @return Row for each source with distances indexed like targets, INF if unreachable.
+     */
+    auto many_to_many(const std::vector<Index>& sources,
+                      const std::vector<Index>& targets) const -> std::vector<ShortestPaths>;
+
+    /**
+     * Append nodes of an arc to the route, excluding its tail.
+     */
+    void unpack(Index arc, Graph::Route& route) const;
+
+private:
+    /**
+     * Full upward search without stopping criterion, calls settle(node, distance)
+     * for each settled node. Distances, touched and the queue are the workspace shared by
+     * the searches of one table, reset on return.
+     */
+    template<typename F>
+    void upward(Index s, const Adjacency& arcs, ShortestPaths& distances,
+                std::vector<Index>& touched, QuaternaryHeap& queue, F&& settle) const;
+
+    std::uint64_t m_fingerprint = 0;
+    std::vector<Index> m_rank {};
+    std::vector<Arc> m_arcs {};
+    Adjacency m_up {};
+    Adjacency m_down {};
+};
+} // namespace graphs
+
+#endif // GRAPHS_HIERARCHY_HPP
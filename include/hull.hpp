@@ -0,0 +1,26 @@
+#ifndef GRAPHS_HULL_HPP
+#define GRAPHS_HULL_HPP
+
+#include "utils.hpp"
+
+namespace graphs {
+/**
+ * Concave hull of a set of locations by digging into the convex hull.
+ *
+ * Starting from the convex hull, every boundary edge that is long compared to its distance
+ * to the closest inner point is split at that point, as long as the boundary stays simple.
+ * Distances are measured in a local equirectangular projection, so on the scale of a city
+ * they are close to meters.
+ *
+ * @param concavity Ratio of the edge length to the distance from the point to the nearer end
+ *                  above which the edge is dug in; smaller values give tighter outlines,
+ *                  infinity gives the convex hull.
+ * @param threshold Edges shorter than it (in meters) are never dug in.
+ * @return Boundary ring counterclockwise, not closed; the locations themselves if there are
+ *         fewer than three distinct ones.
+ */
+auto concave_hull(const Locations& locations, double concavity = 2,
+                  Distance threshold = 0) -> Locations;
+} // namespace graphs
+
+#endif // GRAPHS_HULL_HPP
@@ -0,0 +1,97 @@
+#ifndef GRAPHS_LABELS_HPP
+#define GRAPHS_LABELS_HPP
+
+#include <memory>
+
+#include "hierarchy.hpp"
+
+namespace fs = std::filesystem;
+
+namespace graphs {
+/**
+ * Hub labeling distance oracle derived from a Contraction Hierarchy.
+ *
+ * Every node keeps a forward label (hubs reachable from it with the distances) and a backward
+ * one (hubs reaching it). Labels are the pruned upward search spaces: a shortest path meets
+ * at its highest ranked node, which is a hub of both ends, so the distance is the minimum
+ * over the common hubs of the two labels. Labels are sorted by hub, a query is a merge-join.
+ *
+ * All labels live in one flat buffer (offsets, hubs and distances of each direction), which is
+ * written to the cache verbatim and memory-mapped back on load.
+ */
+struct HubLabels {
+    using Index = Graph::Index;
+
+    /**
+     * Hubs with the distances to (or from) them, sorted by hub.
+     */
+    struct Label {
+        const Index* hubs;
+        const Distance* distances;
+        std::size_t size;
+    };
+
+    HubLabels() = default;
+
+    /**
+     * Compute labels in decreasing rank order: label of a node is merged from the labels of
+     * its upper neighbours, then hubs that the already known labels reach shorter are pruned.
+     */
+    explicit HubLabels(const Hierarchy& hierarchy);
+
+    bool serialize(const fs::path& filename) const;
+    /**
+     * Load the dump of the graph with the given Graph::fingerprint, false if it is missing
+     * or was built from another graph.
+     */
+    bool deserialize(const fs::path& filename, std::uint64_t fingerprint);
+
+    [[nodiscard]] bool empty() const { return m_storage == nullptr; }
+    [[nodiscard]] std::size_t size() const { return m_size; }
+
+    [[nodiscard]] Label forward(Index v) const { return label(m_forward, v); }
+    [[nodiscard]] Label backward(Index v) const { return label(m_backward, v); }
+
+    /**
+     * Distance between two nodes, INF if t is unreachable.
+     */
+    [[nodiscard]] Distance distance(Index s, Index t) const {
+        return join(forward(s), backward(t));
+    }
+
+    /**
+     * Minimal sum of distances over the hubs common to both labels.
+     * Blocks of four hubs are compared all-against-all with SSE2 where available.
+     */
+    static Distance join(const Label& lhs, const Label& rhs);
+
+private:
+    /**
+     * Label arrays of one direction inside the flat buffer.
+     */
+    struct Direction {
+        const std::uint64_t* offsets = nullptr;
+        const Index* hubs = nullptr;
+        const Distance* distances = nullptr;
+    };
+
+    static Label label(const Direction& direction, Index v) {
+        const auto begin = direction.offsets[v], end = direction.offsets[v + 1];
+        return { direction.hubs + begin, direction.distances + begin, end - begin };
+    }
+
+    /**
+     * Resolve the arrays of the buffer starting at data, returns its size in bytes.
+     */
+    std::size_t attach(const char* data);
+
+    std::shared_ptr<const void> m_storage {};
+    const char* m_data = nullptr;
+    std::size_t m_bytes = 0;
+    std::size_t m_size = 0;
+    Direction m_forward {};
+    Direction m_backward {};
+};
+} // namespace graphs
+
+#endif // GRAPHS_LABELS_HPP
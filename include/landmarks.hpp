@@ -0,0 +1,93 @@
+#ifndef GRAPHS_LANDMARKS_HPP
+#define GRAPHS_LANDMARKS_HPP
+
+#include "graph.hpp"
+
+namespace fs = std::filesystem;
+
+namespace graphs {
+/**
+ * Landmarks for goal-directed search (ALT: A*, landmarks, triangle inequality).
+ *
+ * For a few landmark nodes L distances from and to every node are stored, so that
+ *   d(v, t) >= d(L, t) - d(L, v)  and  d(v, t) >= d(v, L) - d(t, L)
+ * bound the remaining distance of the search from below.
+ * Distances are kept node-major: bounds of one node read a single contiguous row.
+ */
+struct Landmarks {
+    using Index = Graph::Index;
+
+    static constexpr std::size_t COUNT = 8;
+    /**
+     * Differences of rounded path lengths may overshoot the true distance by a few ulps,
+     * tight bounds are shrunk by SLACK to stay below it.
+     */
+    static constexpr Distance SLACK = 1 - 1e-9;
+
+    enum class Selection {
+        /**
+         * Each next landmark is the node furthest from the chosen ones.
+         */
+        Farthest,
+        /**
+         * Each next landmark is a leaf of the subtree of a shortest paths tree
+         * where the current bounds are the weakest (Goldberg and Werneck).
+         */
+        Avoid
+    };
+
+    Landmarks() = default;
+
+    /**
+     * Select landmarks and compute their distance tables.
+     */
+    explicit Landmarks(const Graph& graph, std::size_t count = COUNT,
+                       Selection selection = Selection::Avoid);
+
+    bool serialize(const fs::path& filename) const;
+    /**
+     * Load the dump of the graph with the given Graph::fingerprint, false if it is missing
+     * or was built from another graph.
+     */
+    bool deserialize(const fs::path& filename, std::uint64_t fingerprint);
+
+    [[nodiscard]] bool empty() const { return m_landmarks.empty(); }
+    [[nodiscard]] std::size_t count() const { return m_landmarks.size(); }
+    const auto& landmarks() const { return m_landmarks; }
+
+    /**
+     * Lower bound of the distance from one node to another, 0 if the tables say nothing.
+     * Nodes that cannot reach the other one may get any finite bound.
+     */
+    [[nodiscard]] Distance bound(Index from, Index to) const;
+
+private:
+    void add(const Graph& graph, Index landmark);
+
+    std::uint64_t m_fingerprint = 0;
+    std::vector<Index> m_landmarks {};
+    ShortestPaths m_from {};
+    ShortestPaths m_to {};
+};
+
+/**
+ * Landmark lower bound of the distance to the closest target.
+ */
+struct LandmarkPotential {
+    LandmarkPotential(const Landmarks& landmarks, const std::vector<Graph::Index>& targets)
+        : m_landmarks(landmarks)
+        , m_targets(targets) {}
+
+    Distance operator()(Graph::Index v) const {
+        auto result = Graph::INF;
+        for (auto t: m_targets) { result = std::min(result, m_landmarks.bound(v, t)); }
+        return result;
+    }
+
+private:
+    const Landmarks& m_landmarks;
+    std::vector<Graph::Index> m_targets;
+};
+} // namespace graphs
+
+#endif // GRAPHS_LANDMARKS_HPP
@@ -4,6 +4,13 @@
 #include "utils.hpp"
 #include "building.hpp"
 #include "graph.hpp"
+#include "hierarchy.hpp"
+#include "customizable.hpp"
+#include "phast.hpp"
+#include "landmarks.hpp"
+#include "labels.hpp"
+#include "hull.hpp"
+#include "potential.hpp"
 
 namespace fs = std::filesystem;
 
@@ -13,7 +20,10 @@ struct Map {
 
     Map(Buildings buildings, Graph graph)
         : m_buildings(std::move(buildings))
-        , m_graph(std::move(graph)) {};
+        , m_graph(std::move(graph)) {
+        m_graph.freeze();
+        index_buildings();
+    };
 
     /**
      * Pair of Buildings with the Distance between them.
@@ -48,6 +58,66 @@ struct Map {
     using Paths = std::vector<Path>;
     using TracedPaths = std::vector<TracedPath>;
 
+    /**
+     * Partition of the map by the closest site of every node, refers to the map.
+     */
+    struct Voronoi {
+        /**
+         * Path between the building and its closest site, from the building itself at INF
+         * if no site is reachable.
+         */
+        [[nodiscard]] auto nearest(const Building& building) const -> Path;
+
+    private:
+        friend struct Map;
+
+        Voronoi(const Map& map, Buildings sites, Graph::Direction direction);
+
+        const Map& m_map;
+        Buildings m_sites;
+        Graph::Direction m_direction;
+        ShortestPaths m_distances {};
+        std::vector<Graph::Index> m_owners {};
+    };
+
+    /**
+     * Part of the map reachable from a Building within a cutoff.
+     */
+    struct Isochrone {
+        using Segment = std::pair<Node, Node>;
+
+        Isochrone(Distance cutoff, std::vector<Segment> edges, Locations polygon)
+            : m_cutoff(cutoff)
+            , m_edges(std::move(edges))
+            , m_polygon(std::move(polygon)) {};
+
+        [[nodiscard]] Distance cutoff() const { return m_cutoff; }
+        /**
+         * Edges reachable within the cutoff but not within the previous one.
+         */
+        [[nodiscard]] const auto& edges() const { return m_edges; }
+        /**
+         * Concave hull of every node within the cutoff, counterclockwise and not closed.
+         */
+        [[nodiscard]] const Locations& polygon() const { return m_polygon; }
+
+    private:
+        Distance m_cutoff;
+        std::vector<Segment> m_edges;
+        Locations m_polygon;
+    };
+
+    using Isochrones = std::vector<Isochrone>;
+
+    /**
+     * Speed-up structures to build, hub labels need the hierarchy too.
+     */
+    struct Preprocessing {
+        bool hierarchy = true;
+        bool labels = false;
+        bool landmarks = false;
+    };
+
     /**
      * Select buildings by applying functor to each.
      *
@@ -72,27 +142,176 @@ struct Map {
     /**
      * Get shortest paths from Node to all other Nodes specified.
      *
+     * @param cutoff Buildings further than it get infinite distance.
      * @return Mapping from Nodes to the corresponding paths from the given Node.
      */
-    auto shortest_paths_with_trace(Building from, const Buildings& to) const -> TracedPaths;
-    auto shortest_paths(Building from, const Buildings& to) const -> Paths;
+    auto shortest_paths_with_trace(Building from, const Buildings& to,
+                                   Distance cutoff = Graph::INF) const -> TracedPaths;
+    auto shortest_paths(Building from, const Buildings& to,
+                        Distance cutoff = Graph::INF) const -> Paths;
+
+    /**
+     * Partition the map by the closest of the sites in a single multi-source search.
+     *
+     * @param direction Backward measures the distance to the sites, forward from them.
+     */
+    auto voronoi(const Buildings& sites,
+                 Graph::Direction direction = Graph::Direction::Backward) const -> Voronoi;
+
+    /**
+     * Get shortest paths from each of the Buildings to one, by a single reverse search.
+     */
+    auto shortest_paths_to(const Buildings& from, Building to,
+                           Distance cutoff = Graph::INF) const -> Paths;
+
+    /**
+     * Get paths to all Buildings of the map no further than the radius, closest first.
+     */
+    auto buildings_within(Building from, Distance radius) const -> Paths;
+
+    /**
+     * Get isochrones of a Building for several cutoffs by a single search.
+     *
+     * @param concavity Outline tightness, see concave_hull().
+     * @return Isochrone of each cutoff, in increasing order of the cutoffs.
+     */
+    auto isochrones(Building from, std::vector<Distance> cutoffs,
+                    double concavity = 2) const -> Isochrones;
+
+    /**
+     * Get round trips from a Building to each of the others and back.
+     */
+    auto round_trips(Building from, const Buildings& to) const -> Paths;
+
+    /**
+     * Get shortest paths to a few Buildings with goal-directed search (A*).
+     *
+     * @param heuristic Lower bound of the remaining distance, haversine without landmarks.
+     * @param cutoff Buildings further than it get infinite distance and an empty path.
+     */
+    auto goal_directed_paths(Building from, const Buildings& to,
+                             Heuristic heuristic = Heuristic::Haversine,
+                             Distance cutoff = Graph::INF) const -> TracedPaths;
 
+    /**
+     * Get shortest paths from Node to every Node of the map, indexed like nodes().
+     * PHAST sweeps if the map is contracted, parallel delta-stepping otherwise.
+     */
     auto dijkstra(const Node& s) -> ShortestPaths;
+    auto dijkstra(const Nodes& sources) const -> std::vector<ShortestPaths>;
+
+    /**
+     * Get the shortest path between two Buildings by the fastest structure the map has.
+     */
+    auto distance(Building from, Building to) const -> Path;
+    auto distance_with_trace(Building from, Building to) const -> TracedPath;
+
+    /**
+     * Get distances between every pair of Buildings, row i holding the paths from from[i].
+     * Without a speed-up structure, sources are searched together in batches of Graph::LANES
+     * when there are enough of them to fill one.
+     */
+    auto distance_table(const Buildings& from, const Buildings& to) const -> std::vector<Paths>;
 
     /**
      * Summarize all edges' weights.
      */
     auto weights_sum() const -> long double;
 
+    /**
+     * Build Contraction Hierarchy of the routing graph for fast point-to-point queries.
+     */
+    void contract() {
+        m_hierarchy = Hierarchy { m_graph };
+        m_phast = Phast { m_hierarchy };
+    }
+
+    /**
+     * Order the routing graph for customize(), no query may run meanwhile.
+     */
+    void prepare_customization() { m_customizable = CustomizableHierarchy { m_graph }; }
+
+    /**
+     * Replace the weights of the edges, indexed like graph().weights(), for distance() and
+     * distance_table(); queries running meanwhile finish on the old ones.
+     *
+     * @return false if prepare_customization() was not called.
+     * @throws std::invalid_argument if there is not one weight per edge.
+     */
+    bool customize(const std::vector<Distance>& weights) {
+        if (m_customizable.empty()) { return false; }
+        m_customizable.customize(weights);
+        return true;
+    }
+
+    /**
+     * Derive hub labels from the Contraction Hierarchy, the map has to be contracted.
+     */
+    void build_labels() { m_labels = HubLabels { m_hierarchy }; }
+
+    /**
+     * Select landmarks and compute their distance tables for goal-directed search.
+     */
+    void select_landmarks(std::size_t count = Landmarks::COUNT) {
+        m_landmarks = Landmarks { m_graph, count };
+    }
+
+    /**
+     * Build the requested structures the map lacks and dump each of them next to the cache.
+     */
+    void preprocess(const Preprocessing& preprocessing, const fs::path& filename);
+
     bool serialize(const fs::path& filename) const;
     bool deserialize(const fs::path& filename);
 
     const auto& buildings() const { return m_buildings; }
     const auto& nodes() const { return m_graph.nodes(); }
+    const auto& graph() const { return m_graph; }
+    const auto& hierarchy() const { return m_hierarchy; }
+    const auto& customizable() const { return m_customizable; }
+    const auto& landmarks() const { return m_landmarks; }
+    const auto& labels() const { return m_labels; }
 
 private:
+    /**
+     * Indices of the routing nodes closest to the buildings.
+     */
+    auto closest_nodes(const Buildings& buildings) const -> std::vector<Graph::Index>;
+
+    /**
+     * Build the reverse index from routing nodes to the Buildings closest to them.
+     */
+    void index_buildings();
+
+    /**
+     * Shortest path between two nodes by the fastest engine the map has prepared:
+     * the customized hierarchy, the contracted one, A* with landmarks, bidirectional search.
+     */
+    auto route(Graph::Index s, Graph::Index t) const -> std::pair<Distance, Graph::Route>;
+
+    /**
+     * Reconstruct paths to the targets from the search trail.
+     *
+     * @param distances, trail Distance and predecessor of a node: [](Graph::Index) { ... }.
+     */
+    template<typename Distances, typename Trail>
+    auto traced_paths(Building from, const Buildings& to,
+                      const std::vector<Graph::Index>& targets,
+                      const Distances& distances,
+                      const Trail& trail) const -> TracedPaths;
+
     Buildings m_buildings {};
     Graph m_graph {};
+    /**
+     * Buildings of each node: positions in m_buildings, CSR layout like the graph.
+     */
+    std::vector<std::uint32_t> m_residents_offsets { 0 };
+    std::vector<std::uint32_t> m_residents {};
+    Hierarchy m_hierarchy {};
+    CustomizableHierarchy m_customizable {};
+    Phast m_phast {};
+    Landmarks m_landmarks {};
+    HubLabels m_labels {};
 };
 
 using Maps = std::vector<Map>;
@@ -106,10 +325,13 @@ auto paths_to_map(const Map& map, const Map::TracedPaths& paths) -> Map;
  * Constructs routing graph based on provided PBF file with OSM geodata.
  *
  * @param file PBF file.
- * @param recache Object should be constructed from scratch and dumped.
- * @return Constructed routing graph and the list of buildings.
+ * @param recache Object should be constructed from scratch and dumped; a cache that cannot
+ *                be read back in the current layout is rebuilt the same way.
+ * @param preprocessing Speed-up structures to build, only the missing ones for a cached map.
+ * @return Constructed routing graph and the list of buildings, nullopt if the file is missing.
  */
-auto import_map_from_pbf(const fs::path& filename, bool recache) -> std::optional<Map>;
+auto import_map_from_pbf(const fs::path& filename, bool recache,
+                         const Map::Preprocessing& preprocessing = {}) -> std::optional<Map>;
 
 /**
  * Import adjacency matrix from .csv file.
@@ -49,11 +49,54 @@ private:
 
 using Nodes = std::vector<Node>;
 
+/**
+ * Nodes as a structure of arrays: OSM ids, latitudes and longitudes each in its own array,
+ * so a pass over the coordinates does not drag the ids along. Nodes are assembled on access.
+ */
+struct NodeStore {
+    void push_back(const Node& node) {
+        m_ids.push_back(node.id());
+        m_latitudes.push_back(node.latitude());
+        m_longitudes.push_back(node.longitude());
+    }
+
+    void reserve(std::size_t n) {
+        m_ids.reserve(n);
+        m_latitudes.reserve(n);
+        m_longitudes.reserve(n);
+    }
+
+    [[nodiscard]] std::size_t size() const { return m_ids.size(); }
+    [[nodiscard]] bool empty() const { return m_ids.empty(); }
+
+    [[nodiscard]] Node operator[](std::size_t i) const {
+        return { m_ids[i], m_latitudes[i], m_longitudes[i] };
+    }
+    [[nodiscard]] std::uint64_t id(std::size_t i) const { return m_ids[i]; }
+    [[nodiscard]] Angle latitude(std::size_t i) const { return m_latitudes[i]; }
+    [[nodiscard]] Angle longitude(std::size_t i) const { return m_longitudes[i]; }
+    [[nodiscard]] auto location(std::size_t i) const -> Location {
+        return { m_latitudes[i], m_longitudes[i] };
+    }
+
+    friend class boost::serialization::access;
+    template<typename Archive>
+    void serialize(Archive& archive, const unsigned int& version) {
+        (void) version;
+        archive & m_ids & m_latitudes & m_longitudes;
+    }
+
+private:
+    std::vector<std::uint64_t> m_ids {};
+    std::vector<Angle> m_latitudes {};
+    std::vector<Angle> m_longitudes {};
+};
+
 /**
  * Factory function for Node.
  */
 inline auto make_node(const osmium::NodeRef& node) -> Node {
-    return { node.positive_ref(), node.lat(), node.lon() };
+    return { node.positive_ref(), node.y(), node.x() };
 }
 } // namespace graphs
 
@@ -61,14 +104,8 @@ namespace std {
 template<>
 struct hash<graphs::Node> {
     size_t operator()(const graphs::Node& n) const {
-        using boost::hash_value;
-        using boost::hash_combine;
-
-        size_t seed = 0;
-        hash_combine(seed, hash_value(n.id()));
-        hash_combine(seed, hash_value(n.longitude()));
-        hash_combine(seed, hash_value(n.latitude()));
-        return seed;
+        // Equality is defined by OSM id only, so the coordinates need not be hashed.
+        return boost::hash_value(n.id());
     }
 };
 } // namespace std
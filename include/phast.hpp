@@ -0,0 +1,66 @@
+#ifndef GRAPHS_PHAST_HPP
+#define GRAPHS_PHAST_HPP
+
+#include "hierarchy.hpp"
+
+namespace graphs {
+/**
+ * One-to-all shortest paths over a Contraction Hierarchy (PHAST).
+ *
+ * An upward search from the source labels its (small) search space, then a single linear
+ * sweep over all nodes in decreasing rank relaxes the downward arcs: when a node is swept,
+ * every higher ranked node is already final. Nodes are renumbered in the sweep order, so
+ * the sweep reads arrays front to back and only looks back at already swept positions.
+ *
+ * Several sources share a sweep: their labels are interleaved per node, so each arc is
+ * relaxed for all of them by one contiguous, vectorisable loop.
+ */
+struct Phast {
+    using Index = Graph::Index;
+
+    /**
+     * Sources swept together; bounds the interleaved labels to LANES distances per node.
+     */
+    static constexpr std::size_t LANES = 8;
+
+    Phast() = default;
+    explicit Phast(const Hierarchy& hierarchy);
+
+    [[nodiscard]] bool empty() const { return m_position.empty(); }
+    [[nodiscard]] std::size_t size() const { return m_position.size(); }
+
+    /**
+     * Distances from the source to every node, indexed by Graph::Index. A single source
+     * sweeps one lane only, so it touches an eighth of the labels of a full batch.
+     */
+    auto distances(Index s) const -> ShortestPaths;
+
+    /**
+     * Distances from each of the sources to every node, LANES sources per sweep.
+     */
+    auto distances(const std::vector<Index>& sources) const -> std::vector<ShortestPaths>;
+
+private:
+    /**
+     * Arcs of every node in CSR layout over sweep positions.
+     */
+    struct Adjacency {
+        std::vector<Index> offsets { 0 };
+        std::vector<Index> nodes {};
+        std::vector<Distance> weights {};
+    };
+
+    /**
+     * Labels of up to Lanes sources interleaved by sweep position: upward searches and then
+     * the sweep.
+     */
+    template<std::size_t Lanes>
+    void sweep(const Index* sources, std::size_t count, std::vector<Distance>& labels) const;
+
+    std::vector<Index> m_position {};
+    Adjacency m_up {};
+    Adjacency m_down {};
+};
+} // namespace graphs
+
+#endif // GRAPHS_PHAST_HPP
@@ -0,0 +1,85 @@
+#ifndef GRAPHS_POTENTIAL_HPP
+#define GRAPHS_POTENTIAL_HPP
+
+#include <cmath>
+
+#include "graph.hpp"
+
+/*
+ * Potentials for goal-directed search: lower bounds of the distance from a node
+ * to the closest of the targets, computed from coordinates alone.
+ */
+namespace graphs {
+enum class Heuristic {
+    Haversine,
+    Equirectangular,
+    /**
+     * Triangle inequality over precomputed landmark distances, see landmarks.hpp.
+     */
+    Landmarks
+};
+
+/**
+ * Great-circle distance to the closest target.
+ * Edge weights are sums of great-circle segments, so the bound is consistent.
+ */
+struct HaversinePotential {
+    HaversinePotential(const Graph& graph, const std::vector<Graph::Index>& targets)
+        : m_graph(graph) {
+        for (auto t: targets) { m_targets.push_back(graph.nodes().location(t)); }
+    }
+
+    Distance operator()(Graph::Index v) const {
+        const auto location = m_graph.nodes().location(v);
+        auto result = Graph::INF;
+        for (const auto& t: m_targets) { result = std::min(result, haversine(location, t)); }
+        return result;
+    }
+
+private:
+    const Graph& m_graph;
+    Locations m_targets {};
+};
+
+/**
+ * Equirectangular approximation of the distance to the closest target: one cosine and
+ * one square root per evaluation instead of the full haversine formula. Longitude difference
+ * is scaled by the cosine of the latitude closer to a pole and the result is shrunk by SLACK,
+ * which keeps it below the great-circle distance on spans of several degrees.
+ */
+struct EquirectangularPotential {
+    static constexpr double SLACK = 0.999;
+    static constexpr double R = 6'371'000;
+
+    EquirectangularPotential(const Graph& graph, const std::vector<Graph::Index>& targets)
+        : m_graph(graph) {
+        for (auto t: targets) {
+            const auto phi = radians(graph.nodes().latitude(t));
+            m_targets.push_back({ phi, radians(graph.nodes().longitude(t)), std::cos(phi) });
+        }
+    }
+
+    Distance operator()(Graph::Index v) const {
+        const auto phi = radians(m_graph.nodes().latitude(v));
+        const auto lambda = radians(m_graph.nodes().longitude(v));
+        const auto cos_phi = std::cos(phi);
+        auto result = Graph::INF;
+        for (const auto& t: m_targets) {
+            const auto x = (lambda - t.lambda) * std::min(cos_phi, t.cos_phi);
+            const auto y = phi - t.phi;
+            result = std::min(result, SLACK * R * std::sqrt(x * x + y * y));
+        }
+        return result;
+    }
+
+private:
+    struct Target {
+        double phi, lambda, cos_phi;
+    };
+
+    const Graph& m_graph;
+    std::vector<Target> m_targets {};
+};
+} // namespace graphs
+
+#endif // GRAPHS_POTENTIAL_HPP
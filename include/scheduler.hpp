@@ -0,0 +1,154 @@
+#ifndef GRAPHS_SCHEDULER_HPP
+#define GRAPHS_SCHEDULER_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace graphs {
+/**
+ * Work-stealing task scheduler over a fixed set of worker threads.
+ *
+ * Every worker owns a deque: it pushes and pops its own tasks at the back and, once that is
+ * empty, steals from the front of the others. A parallel loop hands out its chunks through a
+ * shared counter, the caller takes them too and then waits only for the ones still running,
+ * so nested parallel loops do not deadlock and a loop never waits on unrelated tasks.
+ *
+ * Parallel work of the whole process goes to instance(), so independent tasks and the loops
+ * nested in them share one set of workers instead of competing threads.
+ */
+struct Scheduler {
+    using Task = std::function<void()>;
+
+    /**
+     * @param threads Number of workers, the hardware concurrency by default.
+     */
+    explicit Scheduler(unsigned threads = std::max(1u, std::thread::hardware_concurrency()));
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    [[nodiscard]] unsigned size() const { return static_cast<unsigned>(m_workers.size()); }
+
+    /**
+     * Scheduler shared by the whole process, started on first use.
+     */
+    static Scheduler& instance();
+
+    /**
+     * Set the number of workers of instance(), the hardware concurrency by default.
+     * Has no effect once it is started.
+     */
+    static void configure(unsigned threads);
+
+    /**
+     * Run the tasks in parallel and return once all of them are done.
+     */
+    template<typename... F>
+    void invoke(F&&... tasks) {
+        std::array<Task, sizeof...(F)> all { Task { std::forward<F>(tasks) }... };
+        parallel_for(all.size(), 1, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; i += 1) { all[i](); }
+        });
+    }
+
+    /**
+     * Call body(begin, end) for consecutive chunks of [0, count) of at most grain items,
+     * in parallel, and return once all of them are done. The caller runs chunks as well.
+     * If a body throws, the chunks not started yet are skipped and the first exception is
+     * rethrown here once the others have finished.
+     */
+    template<typename F>
+    void parallel_for(std::size_t count, std::size_t grain, F&& body) {
+        if (count == 0) { return; }
+        grain = std::max<std::size_t>(grain, 1);
+        const auto chunks = (count + grain - 1) / grain;
+        if (chunks == 1 || size() == 0) {
+            body(std::size_t { 0 }, count);
+            return;
+        }
+
+        // Helpers that start after the loop ended find no chunk left and touch only the state.
+        auto loop = std::make_shared<Loop>(chunks);
+        const auto helpers = std::min<std::size_t>(chunks - 1, size());
+        for (std::size_t k = 0; k < helpers; k += 1) {
+            submit([loop, count, grain, &body] { claim(*loop, count, grain, body); });
+        }
+        claim(*loop, count, grain, body);
+        while (loop->done.load(std::memory_order_acquire) != chunks) {
+            std::this_thread::yield();
+        }
+        if (loop->error) { std::rethrow_exception(loop->error); }
+    }
+
+private:
+    /**
+     * Progress of one parallel loop, shared with the helpers that may outlive it.
+     */
+    struct Loop {
+        explicit Loop(std::size_t chunks) : chunks(chunks) {}
+
+        const std::size_t chunks;
+        std::atomic<std::size_t> next { 0 };
+        std::atomic<std::size_t> done { 0 };
+        std::atomic<bool> failed { false };
+        std::exception_ptr error {};
+    };
+
+    /**
+     * Run chunks of the loop until none is left.
+     */
+    template<typename F>
+    static void claim(Loop& loop, std::size_t count, std::size_t grain, F& body) {
+        for (auto c = loop.next.fetch_add(1); c < loop.chunks; c = loop.next.fetch_add(1)) {
+            if (!loop.failed.load(std::memory_order_relaxed)) {
+                try {
+                    body(c * grain, std::min(count, (c + 1) * grain));
+                } catch (...) {
+                    if (!loop.failed.exchange(true)) { loop.error = std::current_exception(); }
+                }
+            }
+            loop.done.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    /**
+     * Push to the own deque of the calling worker, round-robin from other threads.
+     */
+    void submit(Task task);
+
+    /**
+     * Run one task of the own deque or a stolen one.
+     *
+     * @return Whether there was a task to run.
+     */
+    bool run_one();
+
+    void work(unsigned index);
+
+    std::vector<std::unique_ptr<Queue>> m_queues {};
+    std::vector<std::thread> m_workers {};
+    std::atomic<std::size_t> m_queued { 0 };
+    std::atomic<unsigned> m_next { 0 };
+
+    std::mutex m_mutex {};
+    std::condition_variable m_wake {};
+    bool m_stop = false;
+};
+} // namespace graphs
+
+#endif // GRAPHS_SCHEDULER_HPP
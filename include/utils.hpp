@@ -6,6 +6,8 @@
 #include <fstream>
 #include <filesystem>
 #include <numeric>
+#include <cstdint>
+#include <cmath>
 
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
@@ -15,10 +17,20 @@
 
 namespace graphs {
 using Distance = double;
-using Angle = long double;
+/**
+ * Coordinate in the fixed-point form of osmium: degrees times osmium::coordinate_precision
+ * in 32 bits, about a centimetre of resolution.
+ */
+using Angle = std::int32_t;
 using Location = std::pair<Angle, Angle>;
 using Locations = std::vector<Location>;
 
+/**
+ * Tag at the start of the dumps holding coordinates, changed with their layout: a dump
+ * of another layout is rejected, so the map is imported again instead of read as garbage.
+ */
+constexpr std::uint64_t COORDINATES_FORMAT = 0x323344524f4f4347; // "GCOORD32"
+
 template<typename T>
 bool serialize(const std::string& filename, T&& data) {
     std::ofstream binary { filename, std::ios::out | std::ios::binary | std::ios::app };
@@ -38,11 +50,25 @@ bool deserialize(const std::string& filename, T&& data) {
     return true;
 }
 
+/**
+ * Angle of a fixed-point coordinate in degrees, for the output.
+ */
+constexpr double degrees(Angle angle) {
+    return static_cast<double>(angle) / osmium::coordinate_precision;
+}
+
+/**
+ * Angle of a fixed-point coordinate in radians, for the geometry.
+ */
+constexpr double radians(Angle angle) {
+    return static_cast<double>(angle) * (M_PI / 180 / osmium::coordinate_precision);
+}
+
 /**
  * Factory method for Position.
  */
 inline auto make_pos(const osmium::NodeRef& node) -> Location {
-    return { node.lat(), node.lon() };
+    return { node.y(), node.x() };
 }
 
 /**
@@ -54,13 +80,13 @@ inline auto make_pos(const osmium::NodeRef& node) -> Location {
 inline auto haversine(const Location& x, const Location& y) -> Distance {
     const auto[lat_1, lon_1] = x;
     const auto[lat_2, lon_2] = y;
-    constexpr long double R = 6'371'000;
+    constexpr double R = 6'371'000;
 
     // Convert to radians
-    const auto phi1 = lat_1 * M_PI / 180;
-    const auto phi2 = lat_2 * M_PI / 180;
-    const auto d_phi = (lat_2 - lat_1) * M_PI / 180;
-    const auto d_lambda = (lon_2 - lon_1) * M_PI / 180;
+    const auto phi1 = radians(lat_1);
+    const auto phi2 = radians(lat_2);
+    const auto d_phi = phi2 - phi1;
+    const auto d_lambda = radians(lon_2) - radians(lon_1);
 
     // Square of half the chord length between the objects
     const auto a = std::pow(std::sin(d_phi / 2), 2) +
@@ -72,30 +98,33 @@ inline auto haversine(const Location& x, const Location& y) -> Distance {
 
 /**
  * Determines the geographical center of a building consisting of ambient nodes.
+ * Nodes without a location, e.g. missing from the extract, are left out.
  *
  * @param nodes List of nodes of an OSM way.
  * @return Geocenter described by a pair of latitude and longitude respectively.
  */
 inline auto barycenter(const osmium::WayNodeList& nodes) -> Location {
-    const auto lat = std::accumulate(nodes.cbegin(), nodes.cend(), static_cast<long double>(0),
-                                     [](auto lhs, const auto& node) { return lhs + node.lat(); });
-    const auto lon = std::accumulate(nodes.cbegin(), nodes.cend(), static_cast<long double>(0),
-                                     [](auto lhs, const auto& node) { return lhs + node.lon(); });
-    const auto num = nodes.size();
-
-    return { lat / num, lon / num };
+    std::int64_t lat = 0, lon = 0, num = 0;
+    for (const auto& node: nodes) {
+        if (!node.location().valid()) { continue; }
+        lat += node.y(), lon += node.x(), num += 1;
+    }
+    if (num == 0) { return {}; }
+
+    return { static_cast<Angle>(lat / num), static_cast<Angle>(lon / num) };
 }
 
 inline auto barycenter(const Locations& locations) -> Location {
     const auto
-        lat = std::accumulate(locations.cbegin(), locations.cend(), static_cast<long double>(0),
+        lat = std::accumulate(locations.cbegin(), locations.cend(), static_cast<std::int64_t>(0),
                               [](auto lhs, const auto& node) { return lhs + node.first; });
     const auto
-        lon = std::accumulate(locations.cbegin(), locations.cend(), static_cast<long double>(0),
+        lon = std::accumulate(locations.cbegin(), locations.cend(), static_cast<std::int64_t>(0),
                               [](auto lhs, const auto& node) { return lhs + node.second; });
-    const auto num = locations.size();
+    const auto num = static_cast<std::int64_t>(locations.size());
+    if (num == 0) { return {}; }
 
-    return { lat / num, lon / num };
+    return { static_cast<Angle>(lat / num), static_cast<Angle>(lon / num) };
 }
 } // namespace graph
 
@@ -0,0 +1,104 @@
+#ifndef GRAPHS_WORKSPACE_HPP
+#define GRAPHS_WORKSPACE_HPP
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+
+#include "heap.hpp"
+
+namespace graphs {
+/**
+ * Reusable state of a shortest paths search: distances, predecessors, target marks and
+ * the queue, sized to the graph once.
+ *
+ * Every entry carries the version of the search that wrote it, so reset() only bumps
+ * the version and the arrays are never refilled between queries; a node not touched by
+ * the current search reads as INF and NONE.
+ *
+ * @tparam Queue Priority queue policy from heap.hpp.
+ */
+template<typename Queue = QuaternaryHeap>
+struct Workspace {
+    using Index = std::uint32_t;
+
+    static constexpr Distance INF = std::numeric_limits<Distance>::max();
+    static constexpr Index NONE = std::numeric_limits<Index>::max();
+
+    Workspace() = default;
+    explicit Workspace(std::size_t n) { fit(n); }
+
+    /**
+     * Grow to n nodes, the queue is rebuilt if it has to grow.
+     */
+    void fit(std::size_t n) {
+        if (n <= m_stamps.size()) { return; }
+        m_stamps.resize(n, 0);
+        m_marks.resize(n, 0);
+        m_distances.resize(n);
+        m_previous.resize(n);
+        m_queue = Queue { n };
+    }
+
+    /**
+     * Forget the previous search in O(1); the queue must be empty or cleared.
+     */
+    void reset() {
+        m_version += 1;
+        if (m_version == 0) {
+            // Wrapped around: old stamps could alias the new versions.
+            std::fill(m_stamps.begin(), m_stamps.end(), 0);
+            std::fill(m_marks.begin(), m_marks.end(), 0);
+            m_version = 1;
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const { return m_stamps.size(); }
+
+    [[nodiscard]] Distance distance(Index v) const {
+        return m_stamps[v] == m_version ? m_distances[v] : INF;
+    }
+    [[nodiscard]] Index previous(Index v) const {
+        return m_stamps[v] == m_version ? m_previous[v] : NONE;
+    }
+    void set(Index v, Distance distance, Index previous) {
+        m_stamps[v] = m_version;
+        m_distances[v] = distance;
+        m_previous[v] = previous;
+    }
+
+    /**
+     * Target marks of the current search.
+     */
+    [[nodiscard]] bool marked(Index v) const { return m_marks[v] == m_version; }
+    void mark(Index v) { m_marks[v] = m_version; }
+    void unmark(Index v) { m_marks[v] = 0; }
+
+    Queue& queue() { return m_queue; }
+
+    /**
+     * Copy the results for the first n nodes out as plain arrays.
+     */
+    [[nodiscard]] auto distances(std::size_t n) const -> std::vector<Distance> {
+        std::vector<Distance> result(n);
+        for (Index v = 0; v < n; v += 1) { result[v] = distance(v); }
+        return result;
+    }
+    [[nodiscard]] auto trail(std::size_t n) const -> std::vector<Index> {
+        std::vector<Index> result(n);
+        for (Index v = 0; v < n; v += 1) { result[v] = previous(v); }
+        return result;
+    }
+
+private:
+    std::uint32_t m_version = 1;
+    std::vector<std::uint32_t> m_stamps {};
+    std::vector<std::uint32_t> m_marks {};
+    std::vector<Distance> m_distances {};
+    std::vector<Index> m_previous {};
+    Queue m_queue { 0 };
+};
+} // namespace graphs
+
+#endif // GRAPHS_WORKSPACE_HPP
@@ -1,81 +1,140 @@
 #include "assessment.hpp"
 
+#include <algorithm>
+#include <optional>
+
+#include "flat_map.hpp"
+
 using namespace graphs;
 
 constexpr auto INF = std::numeric_limits<double>::max();
 
 /**
- * For each Node:
- *   define closest Facility (to, from, to-and-back).
+ * Chunks per worker: smaller ones balance better, larger ones cost less to schedule.
+ */
+constexpr size_t CHUNKS = 4;
+
+/**
+ * Rows of a distance table summarized per task.
  */
-auto closest(const Map& map, const Buildings& from, const Buildings& to) -> Map::Paths {
+constexpr size_t ROWS = 16;
+
+/**
+ * Apply functor to each of the Buildings on the workers and concatenate the results
+ * in the order of the Buildings, so the output does not depend on the scheduling.
+ *
+ * @param functor [](const Building&) -> Map::Paths { return __; }
+ */
+template<typename F>
+auto for_each_building(const Buildings& from, F&& functor) -> Map::Paths {
+    auto& scheduler = Scheduler::instance();
+    const auto grain = std::max<size_t>(1, from.size() / (CHUNKS * scheduler.size()));
+    std::vector<Map::Paths> parts(from.size());
+    scheduler.parallel_for(from.size(), grain,
+                           [&](size_t begin, size_t end) {
+                               for (auto i = begin; i < end; i += 1) {
+                                   parts[i] = functor(from[i]);
+                               }
+                           });
     Map::Paths result;
-    for (const auto& f: from) {
-        const auto paths = map.shortest_paths(f, to);
+    for (auto& part: parts) { result.insert(result.end(), part.begin(), part.end()); }
+    return result;
+}
+
+/**
+ * For each Node:
+ *   define closest Facility (to, from), by one multi-source search over all of them.
+ *
+ * @param direction Backward measures the way to the Facilities, forward the way from them.
+ */
+auto closest(const Map& map, const Buildings& from, const Buildings& to,
+             Graph::Direction direction = Graph::Direction::Backward) -> Map::Paths {
+    const auto partition = map.voronoi(to, direction);
+    return for_each_building(from, [&](const auto& f) {
+        const auto closest = partition.nearest(f);
+        return closest.distance() == INF ? Map::Paths {} : Map::Paths { closest };
+    });
+}
+
+/**
+ * For each Node:
+ *   define closest Facility by the way there and back, the first one on ties.
+ */
+auto closest_round_trip(const Map& map, const Buildings& from, const Buildings& to) -> Map::Paths {
+    return for_each_building(from, [&](const auto& f) {
+        const auto paths = map.round_trips(f, to);
         const auto closest = std::min_element(paths.cbegin(), paths.cend(),
                                               [](const auto& a, const auto& b) {
                                                   return a.distance() < b.distance();
                                               });
-        if (closest->distance() == INF) { continue; }
-        result.push_back(*closest);
-    }
-    return result;
+        if (closest == paths.cend() || closest->distance() == INF) { return Map::Paths {}; }
+        return Map::Paths { *closest };
+    });
 }
 
 /**
  * For each Node:
- *   define Buildings no further than X meters.
+ *   define Buildings no further than X meters, by a search bounded by X.
  */
 auto range(const Map& map, const Buildings& from, const Buildings& to, uint64_t x) -> Map::Paths {
-    Map::Paths result;
-    for (const auto& f: from) {
-        const auto paths = map.shortest_paths(f, to);
-        for (const auto& path: paths) {
-            if (path.distance() <= x) {
-                result.push_back(path);
-            }
+    FlatMap<Building, size_t> position { to.size() };
+    for (size_t i = 0; i < to.size(); i += 1) { position.emplace(to[i], i); }
+
+    return for_each_building(from, [&](const auto& f) {
+        // Neighbourhood of the Building, reported in the order of `to`.
+        std::vector<std::pair<size_t, Map::Path>> found;
+        for (const auto& path: map.buildings_within(f, x)) {
+            auto it = position.find(path.ends().second);
+            if (it != position.end()) { found.emplace_back(it->second, path); }
         }
-    }
-    return result;
+        std::sort(found.begin(), found.end(),
+                  [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+        Map::Paths result;
+        for (const auto&[_, path]: found) { result.push_back(path); }
+        return result;
+    });
 }
 
 /**
- * Define Building that has minimal distance between it and the furthest Node.
+ * Furthest and sum of the paths of one Building to each of the others.
  */
-auto minmax(const Map& map, const Buildings& from, const Buildings& to) -> Building {
-    std::unordered_map<Building, Distance> furthest {};
-    for (const auto& f: from) {
-        const auto paths = map.shortest_paths(f, to);
-        furthest[f] = std::max_element(paths.cbegin(), paths.cend(),
-                                       [](const auto& lhs, const auto& rhs) {
-                                           return lhs.distance() > rhs.distance() &&
-                                                  lhs.distance() < INF;
-                                       })->distance();
-    }
-    const auto result = std::min_element(from.cbegin(), from.cend(),
-                                         [&](const auto& lhs, const auto& rhs) {
-                                             return furthest[lhs] < furthest[rhs];
-                                         });
-    return *result;
+struct Summary {
+    Distance furthest = INF;
+    Distance sum = 0;
+};
+
+/**
+ * Feed every row of the table to both consumers at once: furthest and sum.
+ */
+auto summarize(const std::vector<Map::Paths>& table) -> std::vector<Summary> {
+    std::vector<Summary> result(table.size());
+    Scheduler::instance().parallel_for(table.size(), ROWS, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; i += 1) {
+            const auto& row = table[i];
+            auto& summary = result[i];
+            for (size_t j = 0; j < row.size(); j += 1) {
+                const auto distance = row[j].distance();
+                // Furthest and sum are reduced the way minmax and median always did.
+                if (j == 0 || (summary.furthest > distance && summary.furthest < INF)) {
+                    summary.furthest = distance;
+                }
+                summary.sum = distance < INF ? summary.sum + distance : 0;
+            }
+        }
+    });
+    return result;
 }
 
 /**
- * Define Buildings that has minimal sum of the shortest paths (median).
+ * Position of the Building with the smallest value, the first one on ties.
  */
-auto median(const Map& map, const Buildings& from, const Buildings& to) -> Building {
-    std::unordered_map<Building, Distance> sum {};
-    for (const auto& f: from) {
-        const auto paths = map.shortest_paths(f, to);
-        sum[f] = std::accumulate(paths.cbegin(), paths.cend(), static_cast<double>(0),
-                                 [](double s, const auto& path) {
-                                     return path.distance() < INF ? s += path.distance() : 0;
-                                 });
+template<typename F>
+auto argmin(const std::vector<Summary>& summaries, F&& value) -> std::optional<size_t> {
+    std::optional<size_t> result {};
+    for (size_t i = 0; i < summaries.size(); i += 1) {
+        if (!result || value(summaries[i]) < value(summaries[*result])) { result = i; }
     }
-    const auto result = std::min_element(from.cbegin(), from.cend(),
-                                         [&](const auto& lhs, const auto& rhs) {
-                                             return sum[lhs] < sum[rhs];
-                                         });
-    return *result;
+    return result;
 }
 
 void assessment(const Map& map, int houses_num, int facilities_num) {
@@ -86,55 +145,45 @@ void assessment(const Map& map, int houses_num, int facilities_num) {
     auto houses = map.select_random_houses(houses_num);
     auto facilities = map.select_random_facilities(facilities_num);
 
-    {
-        auto ch2f = closest(map, houses, facilities);
-        auto cf2h = closest(map, facilities, houses);
-
-        report << "Closest house -> facility:\n";
-        for (const auto& path: ch2f) {
-            auto[from, to] = path.ends();
-            report << from.id() << "---" << to.id() << "---" << path.distance() << "\n";
-        }
-
-        report << "Closest facility -> house:\n";
-        for (const auto& path: cf2h) {
-            auto[from, to] = path.ends();
-            report << from.id() << "---" << to.id() << "---" << path.distance() << "\n";
-        }
-    }
-
-    {
-        auto rh2f = range(map, houses, facilities, x);
-        auto rf2h = range(map, facilities, houses, x);
-
-        report << "In range house -> facility:\n";
-        for (const auto& path: rh2f) {
-            auto[from, to] = path.ends();
-            report << from.id() << "---" << to.id() << "---" << path.distance() << "\n";
-        }
-
-        report << "In range facility -> house:\n";
-        for (const auto& path: rf2h) {
+    // Minmax and median share one table per direction, the other sections their own searches.
+    Map::Paths ch2f, cf2h, chff, ch2f2h, rh2f, rf2h;
+    std::vector<Map::Paths> h2f, f2h;
+    Scheduler::instance().invoke(
+        [&] { ch2f = closest(map, houses, facilities); },
+        [&] { cf2h = closest(map, facilities, houses); },
+        [&] { chff = closest(map, houses, facilities, Graph::Direction::Forward); },
+        [&] { ch2f2h = closest_round_trip(map, houses, facilities); },
+        [&] { rh2f = range(map, houses, facilities, x); },
+        [&] { rf2h = range(map, facilities, houses, x); },
+        [&] { h2f = map.distance_table(houses, facilities); },
+        [&] { f2h = map.distance_table(facilities, houses); });
+    const auto from_houses = summarize(h2f);
+    const auto from_facilities = summarize(f2h);
+
+    const auto write = [&](const char* title, const Map::Paths& paths) {
+        report << title << "\n";
+        for (const auto& path: paths) {
             auto[from, to] = path.ends();
             report << from.id() << "---" << to.id() << "---" << path.distance() << "\n";
         }
-    }
-
-    {
-        auto mmh2f = minmax(map, houses, facilities);
-        auto mmf2h = minmax(map, facilities, houses);
-
-        report << "Minmax house -> facility:\n";
-        report << mmh2f.id() << "\n";
-
-        report << "Minmax facility -> house:\n";
-        report << mmf2h.id() << "\n";
-    }
-
-    {
-        auto m = median(map, houses, facilities);
-
-        report << "Median:\n";
-        report << m.id() << "\n";
-    }
+    };
+    const auto write_building = [&](const char* title, const Buildings& buildings,
+                                    std::optional<size_t> position) {
+        report << title << "\n";
+        if (position) { report << buildings[*position].id() << "\n"; }
+    };
+
+    write("Closest house -> facility:", ch2f);
+    write("Closest facility -> house, for each house:", chff);
+    write("Closest house -> facility -> house:", ch2f2h);
+    write("Closest facility -> house:", cf2h);
+
+    write("In range house -> facility:", rh2f);
+    write("In range facility -> house:", rf2h);
+
+    const auto furthest = [](const Summary& s) { return s.furthest; };
+    write_building("Minmax house -> facility:", houses, argmin(from_houses, furthest));
+    write_building("Minmax facility -> house:", facilities, argmin(from_facilities, furthest));
+
+    write_building("Median:", houses, argmin(from_houses, [](const auto& s) { return s.sum; }));
 }
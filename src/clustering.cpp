@@ -88,11 +88,15 @@ auto ClusterStructure::merge_clusters(size_t id1, size_t id2) -> Cluster {
     auto cl2 = m_clusters[id2];
     _m_next[cl1.last()] = cl2.first();
 
+    // Fixed-point coordinates are weighted in 64 bits, signed, as they may be negative.
+    const auto weighted = [&](Angle lhs, Angle rhs) {
+        const auto n1 = static_cast<std::int64_t>(cl1.size());
+        const auto n2 = static_cast<std::int64_t>(cl2.size());
+        return static_cast<Angle>((lhs * n1 + rhs * n2) / (n1 + n2));
+    };
     Location loc;
-    loc.first = (cl1.centroid().location().first * cl1.size() +
-                 cl2.centroid().location().first * cl2.size()) / (cl1.size() + cl2.size());
-    loc.second = (cl1.centroid().location().second * cl1.size() +
-                  cl2.centroid().location().second * cl2.size()) / (cl1.size() + cl2.size());
+    loc.first = weighted(cl1.centroid().location().first, cl2.centroid().location().first);
+    loc.second = weighted(cl1.centroid().location().second, cl2.centroid().location().second);
 
     auto b = find_nearest_building(m_map, loc);
 
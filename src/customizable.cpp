@@ -0,0 +1,416 @@
+#include "customizable.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+#include <boost/serialization/vector.hpp>
+
+#include "scheduler.hpp"
+
+namespace graphs {
+bool CustomizableHierarchy::serialize(const fs::path& filename) const {
+    auto cname = filename;
+    cname.concat("-cch.dmp");
+    std::ofstream binary { cname, std::ios::out | std::ios::binary };
+    boost::archive::binary_oarchive archive { binary, boost::archive::no_header };
+    archive << m_fingerprint << m_rank << m_parent << m_offsets << m_heads << m_tails
+            << m_lower_offsets << m_lower << m_level_offsets << m_levels << m_edges;
+    return true;
+}
+
+bool CustomizableHierarchy::deserialize(const fs::path& filename, std::uint64_t fingerprint) {
+    auto cname = filename;
+    cname.concat("-cch.dmp");
+    if (!std::filesystem::exists(cname)) { return false; }
+    std::ifstream binary { cname, std::ios::binary };
+    boost::archive::binary_iarchive archive { binary, boost::archive::no_header };
+    archive >> m_fingerprint;
+    if (m_fingerprint != fingerprint) {
+        *this = CustomizableHierarchy {};
+        return false;
+    }
+    archive >> m_rank >> m_parent >> m_offsets >> m_heads >> m_tails >> m_lower_offsets
+            >> m_lower >> m_level_offsets >> m_levels >> m_edges;
+    std::atomic_store(&m_metric, std::shared_ptr<const Metric> {});
+    return true;
+}
+} // namespace graphs
+
+namespace graphs {
+namespace {
+using Index = Graph::Index;
+
+constexpr auto INF = Graph::INF;
+
+/**
+ * Cells of at most that many nodes are not dissected further.
+ */
+constexpr size_t LEAF = 8;
+
+/**
+ * Nodes of one level customized per task.
+ */
+constexpr size_t GRAIN = 256;
+
+/**
+ * Nested dissection of the graph into the order of contraction.
+ */
+struct Dissection {
+    explicit Dissection(const Graph& graph)
+        : graph(graph)
+        , cells(graph.size(), 0) {
+        order.reserve(graph.size());
+    }
+
+    /**
+     * Append the nodes of the cell to the order, separators after the parts they separate.
+     */
+    void dissect(std::vector<Index> cell) {
+        if (cell.size() <= LEAF) {
+            order.insert(order.end(), cell.begin(), cell.end());
+            return;
+        }
+
+        // Halves by the median latitude or longitude, whichever needs the smaller separator.
+        std::vector<Index> parts[2], separator;
+        for (auto by_longitude: { false, true }) {
+            auto candidate = split(cell, by_longitude);
+            if (by_longitude && candidate.size() >= separator.size()) { continue; }
+            separator = std::move(candidate);
+            const auto removed = ++label;
+            for (auto v: separator) { cells[v] = removed; }
+            for (auto& part: parts) { part.clear(); }
+            for (auto it = cell.begin(); it != cell.end(); ++it) {
+                if (cells[*it] != removed) { parts[it < cell.begin() + half(cell)].push_back(*it); }
+            }
+        }
+        cell = {};
+        dissect(std::move(parts[1]));
+        dissect(std::move(parts[0]));
+        order.insert(order.end(), separator.begin(), separator.end());
+    }
+
+    static std::ptrdiff_t half(const std::vector<Index>& cell) {
+        return static_cast<std::ptrdiff_t>(cell.size() / 2);
+    }
+
+    /**
+     * Reorder the cell so that its first half lies below the median of the coordinate and
+     * return the boundary of the half with fewer boundary nodes.
+     */
+    auto split(std::vector<Index>& cell, bool by_longitude) -> std::vector<Index> {
+        const auto middle = cell.begin() + half(cell);
+        const auto& nodes = graph.nodes();
+        std::nth_element(cell.begin(), middle, cell.end(), [&](Index a, Index b) {
+            return by_longitude ? nodes.longitude(a) < nodes.longitude(b)
+                                : nodes.latitude(a) < nodes.latitude(b);
+        });
+
+        // Labels are never reused, so the ones left by other cells cannot match.
+        const Index labels[2] = { ++label, ++label };
+        for (auto it = cell.begin(); it != cell.end(); ++it) {
+            cells[*it] = labels[it < middle ? 0 : 1];
+        }
+        std::vector<Index> boundaries[2];
+        for (auto v: cell) {
+            const auto side = cells[v] == labels[0] ? 0 : 1;
+            const auto crosses = [&](const Graph::Edges& edges) {
+                return std::any_of(edges.begin(), edges.end(), [&](const auto& edge) {
+                    return cells[edge.first] == labels[1 - side];
+                });
+            };
+            if (crosses(graph.edges(v)) || crosses(graph.incoming(v))) {
+                boundaries[side].push_back(v);
+            }
+        }
+        return std::move(boundaries[boundaries[0].size() <= boundaries[1].size() ? 0 : 1]);
+    }
+
+    const Graph& graph;
+    std::vector<Index> cells;
+    Index label = 0;
+    std::vector<Index> order {};
+};
+
+/**
+ * Labels of the searches from both ends of a query, INF outside of it.
+ */
+struct Labels {
+    void fit(size_t n) {
+        if (n <= forward.size()) { return; }
+        forward.resize(n, INF);
+        backward.resize(n, INF);
+        forward_arcs.resize(n, Graph::NONE);
+        backward_arcs.resize(n, Graph::NONE);
+    }
+
+    ShortestPaths forward {}, backward {};
+    std::vector<Index> forward_arcs {}, backward_arcs {};
+};
+
+Labels& thread_labels(size_t n) {
+    thread_local Labels labels;
+    labels.fit(n);
+    return labels;
+}
+} // namespace
+
+CustomizableHierarchy::CustomizableHierarchy(const Graph& graph)
+    : m_fingerprint(graph.fingerprint())
+    , m_rank(graph.size(), Graph::NONE)
+    , m_parent(graph.size(), Graph::NONE) {
+    std::vector<Index> order;
+    {
+        Dissection dissection { graph };
+        std::vector<Index> nodes(graph.size());
+        std::iota(nodes.begin(), nodes.end(), 0);
+        dissection.dissect(std::move(nodes));
+        order = std::move(dissection.order);
+    }
+    for (Index r = 0; r < order.size(); r += 1) { m_rank[order[r]] = r; }
+
+    // Contraction without witnesses: higher neighbours of a node become neighbours of each
+    // other, which is to say of the lowest of them, the parent, as its own get merged on.
+    std::vector<std::vector<Index>> higher(size());
+    for (Index v = 0; v < size(); v += 1) {
+        for (const auto&[to, _]: graph.edges(v)) {
+            if (to == v) { continue; }
+            if (m_rank[v] < m_rank[to]) { higher[v].push_back(to); }
+            else { higher[to].push_back(v); }
+        }
+    }
+    const auto by_rank = [&](Index a, Index b) { return m_rank[a] < m_rank[b]; };
+    for (auto v: order) {
+        auto& neighbours = higher[v];
+        std::sort(neighbours.begin(), neighbours.end(), by_rank);
+        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        if (neighbours.empty()) { continue; }
+        m_parent[v] = neighbours.front();
+        auto& parent = higher[neighbours.front()];
+        parent.insert(parent.end(), neighbours.begin() + 1, neighbours.end());
+    }
+
+    for (Index v = 0; v < size(); v += 1) {
+        for (auto to: higher[v]) {
+            m_heads.push_back(to);
+            m_tails.push_back(v);
+        }
+        m_offsets.push_back(m_heads.size());
+        higher[v] = {};
+    }
+
+    m_lower_offsets.assign(size() + 1, 0);
+    for (auto to: m_heads) { m_lower_offsets[to + 1] += 1; }
+    std::partial_sum(m_lower_offsets.begin(), m_lower_offsets.end(), m_lower_offsets.begin());
+    m_lower.resize(m_heads.size());
+    {
+        auto position = m_lower_offsets;
+        for (Index arc = 0; arc < m_heads.size(); arc += 1) {
+            m_lower[position[m_heads[arc]]++] = arc;
+        }
+    }
+
+    std::vector<Index> levels(size(), 0);
+    Index depth = 0;
+    for (auto v: order) {
+        for (auto k = m_lower_offsets[v]; k < m_lower_offsets[v + 1]; k += 1) {
+            levels[v] = std::max(levels[v], levels[m_tails[m_lower[k]]] + 1);
+        }
+        depth = std::max(depth, levels[v] + 1);
+    }
+    m_level_offsets.assign(depth + 1, 0);
+    for (auto level: levels) { m_level_offsets[level + 1] += 1; }
+    std::partial_sum(m_level_offsets.begin(), m_level_offsets.end(), m_level_offsets.begin());
+    m_levels.resize(size());
+    {
+        auto position = m_level_offsets;
+        for (auto v: order) { m_levels[position[levels[v]]++] = v; }
+    }
+
+    m_edges.reserve(graph.edges_count());
+    for (Index v = 0; v < size(); v += 1) {
+        for (const auto&[to, _]: graph.edges(v)) {
+            if (to == v) { m_edges.push_back(Graph::NONE); }
+            else if (m_rank[v] < m_rank[to]) { m_edges.push_back(arc(v, to) << 1); }
+            else { m_edges.push_back(arc(to, v) << 1 | 1); }
+        }
+    }
+}
+
+auto CustomizableHierarchy::arc(Index lower, Index higher) const -> Index {
+    const auto begin = m_heads.begin() + m_offsets[lower];
+    const auto end = m_heads.begin() + m_offsets[lower + 1];
+    const auto it = std::lower_bound(begin, end, higher, [&](Index a, Index b) {
+        return m_rank[a] < m_rank[b];
+    });
+    return it != end && *it == higher ? static_cast<Index>(it - m_heads.begin()) : Graph::NONE;
+}
+
+void CustomizableHierarchy::triangles(Index x, Metric& metric) const {
+    auto& up = metric.up;
+    auto& down = metric.down;
+    for (auto k = m_lower_offsets[x]; k < m_lower_offsets[x + 1]; k += 1) {
+        const auto vx = m_lower[k];
+        const auto v = m_tails[vx];
+        // Neighbours of v above x are neighbours of x too, both lists are sorted by rank.
+        auto xy = m_offsets[x];
+        for (auto vy = vx + 1; vy < m_offsets[v + 1]; vy += 1) {
+            while (m_heads[xy] != m_heads[vy]) { xy += 1; }
+            if (down[vx] + up[vy] < up[xy]) {
+                up[xy] = down[vx] + up[vy], metric.via_up[xy] = vx;
+            }
+            if (down[vy] + up[vx] < down[xy]) {
+                down[xy] = down[vy] + up[vx], metric.via_down[xy] = vx;
+            }
+        }
+    }
+}
+
+void CustomizableHierarchy::customize(const std::vector<Distance>& weights) {
+    if (weights.size() != m_edges.size()) {
+        throw std::invalid_argument { "CustomizableHierarchy::customize: one weight per edge" };
+    }
+    auto metric = std::make_shared<Metric>();
+    metric->up.assign(arcs_count(), INF);
+    metric->down.assign(arcs_count(), INF);
+    metric->via_up.assign(arcs_count(), Graph::NONE);
+    metric->via_down.assign(arcs_count(), Graph::NONE);
+    for (size_t e = 0; e < m_edges.size(); e += 1) {
+        if (m_edges[e] == Graph::NONE) { continue; }
+        auto& input = m_edges[e] & 1 ? metric->down : metric->up;
+        input[m_edges[e] >> 1] = std::min(input[m_edges[e] >> 1], weights[e]);
+    }
+
+    auto& scheduler = Scheduler::instance();
+    for (size_t level = 1; level + 1 < m_level_offsets.size(); level += 1) {
+        const auto first = m_level_offsets[level];
+        scheduler.parallel_for(m_level_offsets[level + 1] - first, GRAIN,
+                               [&](size_t begin, size_t end) {
+                                   for (auto k = first + begin; k < first + end; k += 1) {
+                                       triangles(m_levels[k], *metric);
+                                   }
+                               });
+    }
+
+    const auto previous = this->metric();
+    metric->version = previous ? previous->version + 1 : 1;
+    std::atomic_store(&m_metric, std::shared_ptr<const Metric> { std::move(metric) });
+}
+
+template<typename F>
+void CustomizableHierarchy::upward(Index s, const std::vector<Distance>& weights,
+                                   ShortestPaths& distances, std::vector<Index>& arcs,
+                                   F&& settle) const {
+    distances[s] = 0;
+    for (auto v = s; v != Graph::NONE; v = m_parent[v]) {
+        const auto d = distances[v];
+        if (d == INF) { continue; }
+        settle(v, d);
+        for (auto arc = m_offsets[v]; arc < m_offsets[v + 1]; arc += 1) {
+            if (d + weights[arc] < distances[m_heads[arc]]) {
+                distances[m_heads[arc]] = d + weights[arc];
+                arcs[m_heads[arc]] = arc;
+            }
+        }
+    }
+}
+
+void CustomizableHierarchy::clear(Index s, ShortestPaths& distances) const {
+    for (auto v = s; v != Graph::NONE; v = m_parent[v]) { distances[v] = INF; }
+}
+
+auto CustomizableHierarchy::query(Index s, Index t) const -> std::pair<Distance, Graph::Route> {
+    const auto metric = this->metric();
+    auto& labels = thread_labels(size());
+
+    upward(s, metric->up, labels.forward, labels.forward_arcs, [](auto...) {});
+    Distance best = INF;
+    Index meet = Graph::NONE;
+    upward(t, metric->down, labels.backward, labels.backward_arcs, [&](Index v, Distance d) {
+        if (labels.forward[v] < INF && labels.forward[v] + d < best) {
+            best = labels.forward[v] + d, meet = v;
+        }
+    });
+
+    Graph::Route route;
+    if (meet != Graph::NONE) {
+        // Arcs from the source up to the meeting node and from it down to the target.
+        std::vector<Index> arcs;
+        for (auto v = meet; v != s; v = m_tails[labels.forward_arcs[v]]) {
+            arcs.push_back(labels.forward_arcs[v]);
+        }
+        route.push_back(s);
+        for (auto it = arcs.rbegin(); it != arcs.rend(); ++it) {
+            unpack(*metric, *it, true, route);
+        }
+        for (auto v = meet; v != t; v = m_tails[labels.backward_arcs[v]]) {
+            unpack(*metric, labels.backward_arcs[v], false, route);
+        }
+    }
+    clear(s, labels.forward);
+    clear(t, labels.backward);
+    return { best, route };
+}
+
+auto CustomizableHierarchy::many_to_many(const std::vector<Index>& sources,
+                                         const std::vector<Index>& targets,
+                                         const Metric& metric) const
+-> std::vector<ShortestPaths> {
+    struct Entry {
+        Index target;
+        Distance distance;
+    };
+
+    auto& labels = thread_labels(size());
+
+    std::vector<std::pair<Index, Entry>> entries;
+    for (Index j = 0; j < targets.size(); j += 1) {
+        upward(targets[j], metric.down, labels.backward, labels.backward_arcs,
+               [&](Index v, Distance d) { entries.push_back({ v, { j, d }}); });
+        clear(targets[j], labels.backward);
+    }
+    std::vector<Index> offsets(size() + 1, 0);
+    for (const auto& entry: entries) { offsets[entry.first + 1] += 1; }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<Entry> buckets(entries.size());
+    {
+        auto position = offsets;
+        for (const auto&[v, entry]: entries) { buckets[position[v]++] = entry; }
+    }
+    entries = {};
+
+    std::vector<ShortestPaths> result(sources.size(), ShortestPaths(targets.size(), INF));
+    for (size_t i = 0; i < sources.size(); i += 1) {
+        auto& row = result[i];
+        upward(sources[i], metric.up, labels.forward, labels.forward_arcs,
+               [&](Index v, Distance d) {
+                   for (auto k = offsets[v]; k < offsets[v + 1]; k += 1) {
+                       const auto&[j, distance] = buckets[k];
+                       row[j] = std::min(row[j], d + distance);
+                   }
+               });
+        clear(sources[i], labels.forward);
+    }
+    return result;
+}
+
+void CustomizableHierarchy::unpack(const Metric& metric, Index arc, bool up,
+                                   Graph::Route& route) const {
+    const auto x = m_tails[arc], y = m_heads[arc];
+    const auto vx = up ? metric.via_up[arc] : metric.via_down[arc];
+    if (vx == Graph::NONE) {
+        route.push_back(up ? y : x);
+        return;
+    }
+    // Otherwise the weight came from the triangle x, v, y recorded during customization.
+    const auto vy = this->arc(m_tails[vx], y);
+    if (up) {
+        unpack(metric, vx, false, route);
+        unpack(metric, vy, true, route);
+    } else {
+        unpack(metric, vy, false, route);
+        unpack(metric, vx, true, route);
+    }
+}
+} // namespace graphs
@@ -25,7 +25,7 @@ Point::Point(Location loc, Color color) {
         }},
         { "geometry", {
             { "type", "Point" },
-            { "coordinates", { loc.second, loc.first }}
+            { "coordinates", { degrees(loc.second), degrees(loc.first) }}
         }}
     };
 }
@@ -43,7 +43,30 @@ LineString::LineString(const Locations& locs, Color color) {
 
     for (auto& loc: locs) {
         m_json["geometry"]["coordinates"]
-            .emplace_back(nlohmann::json { loc.second, loc.first });
+            .emplace_back(nlohmann::json { degrees(loc.second), degrees(loc.first) });
+    }
+}
+Polygon::Polygon(const Locations& ring, Color color) {
+    m_json = {
+        { "type", "Feature" },
+        { "properties", {
+            { "stroke", "#" + color.hex() },
+            { "fill", "#" + color.hex() },
+            { "fill-opacity", 0.2 },
+        }},
+        { "geometry", {
+            { "type", "Polygon" },
+            { "coordinates", { nlohmann::json::array() }},
+        }}
+    };
+
+    auto& coordinates = m_json["geometry"]["coordinates"][0];
+    for (auto& loc: ring) {
+        coordinates.emplace_back(nlohmann::json { degrees(loc.second), degrees(loc.first) });
+    }
+    if (!ring.empty()) {
+        coordinates.emplace_back(nlohmann::json { degrees(ring.front().second),
+                                                  degrees(ring.front().first) });
     }
 }
 Point building_to_point(const Building& building, Color color) {
@@ -83,16 +106,38 @@ Features map_to_features(const Map& map, Color color) {
         features.emplace_back(edge);
     }
 
-    for (const auto&[node, edges]: map.nodes()) {
-        for (const auto& edge: edges) {
+    const auto& graph = map.graph();
+    for (Graph::Index v = 0; v < graph.size(); v += 1) {
+        for (const auto&[to, _]: graph.edges(v)) {
             auto edge_geojson =
-                LineString(Locations { node.location(), edge.first.location() }, color);
+                LineString(Locations { graph.node(v).location(), graph.node(to).location() },
+                           color);
             features.emplace_back(edge_geojson);
         }
     }
 
     return features;
 }
+Features isochrone_to_features(const Map::Isochrone& isochrone, Color color) {
+    auto features = Features();
+    for (const auto&[from, to]: isochrone.edges()) {
+        features.emplace_back(LineString(Locations { from.location(), to.location() }, color));
+    }
+    if (isochrone.polygon().size() >= 3) {
+        features.emplace_back(Polygon(isochrone.polygon(), color));
+    }
+    return features;
+}
+Features isochrones_to_features(const Map::Isochrones& isochrones, Colors colors) {
+    if (colors.empty()) { colors = generate_colors(isochrones.size()); }
+    auto features = Features();
+    // Widest isochrone first, so the narrower outlines are drawn over it.
+    for (size_t i = isochrones.size(); i-- > 0;) {
+        auto features_new = isochrone_to_features(isochrones[i], colors[i]);
+        features.insert(features.end(), features_new.begin(), features_new.end());
+    }
+    return features;
+}
 FeatureCollection map_to_geojson(const Map& map, Color color) {
     auto features = map_to_features(map, color);
     auto collection = FeatureCollection();
@@ -1,65 +1,593 @@
 #include "graph.hpp"
 
-#include <unordered_map>
 #include <filesystem>
+#include <algorithm>
+#include <cstring>
 #include <limits>
+#include <atomic>
+#include <numeric>
 
-#include <boost/serialization/unordered_map.hpp>
+#include <boost/serialization/vector.hpp>
 
 #include "utils.hpp"
+#include "potential.hpp"
+#include "landmarks.hpp"
+#include "scheduler.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace graphs {
 bool Graph::serialize(const fs::path& filename) const {
+    if (!frozen()) {
+        auto copy = *this;
+        copy.freeze();
+        return copy.serialize(filename);
+    }
     auto cname = filename;
-    return ::graphs::serialize(cname.concat("-gph.dmp"), m_data);
+    cname.concat("-gph.dmp");
+    std::ofstream binary { cname, std::ios::out | std::ios::binary | std::ios::app };
+    boost::archive::binary_oarchive archive { binary, boost::archive::no_header };
+    archive << COORDINATES_FORMAT << m_nodes << m_offsets << m_targets << m_weights;
+    return true;
 }
 
 bool Graph::deserialize(const fs::path& filename) {
     auto cname = filename;
     cname.concat("-gph.dmp");
     if (!std::filesystem::exists(cname)) { return false; }
-    return ::graphs::deserialize(cname, m_data);
+    std::ifstream binary { cname, std::ios::binary };
+    boost::archive::binary_iarchive archive { binary, boost::archive::no_header };
+    std::uint64_t format = 0;
+    archive >> format;
+    if (format != COORDINATES_FORMAT) { return false; }
+    archive >> m_nodes >> m_offsets >> m_targets >> m_weights;
+    transpose();
+
+    m_data.clear();
+    m_frozen = true;
+    m_index.clear();
+    m_index.reserve(m_nodes.size());
+    for (Index i = 0; i < m_nodes.size(); i += 1) { m_index.insert({ m_nodes.id(i), i }); }
+    return true;
+}
+
+std::uint64_t Graph::fingerprint() const {
+    if (!frozen()) {
+        auto copy = *this;
+        copy.freeze();
+        return copy.fingerprint();
+    }
+    auto result = mix(m_nodes.size() ^ mix(m_targets.size()));
+    const auto add = [&](std::uint64_t value) { result = mix(result ^ value); };
+    for (Index v = 0; v < m_nodes.size(); v += 1) {
+        add(m_nodes.id(v));
+        add(m_offsets[v + 1]);
+    }
+    for (std::size_t e = 0; e < m_targets.size(); e += 1) {
+        std::uint64_t bits;
+        std::memcpy(&bits, &m_weights[e], sizeof(bits));
+        add(m_targets[e]);
+        add(bits);
+    }
+    return result;
 }
 } // namespace graphs
 
 namespace graphs {
+auto Graph::intern(const Node& node) -> Index {
+    auto[it, inserted] = m_index.insert({ node.id(), static_cast<Index>(m_nodes.size()) });
+    if (inserted) {
+        m_nodes.push_back(node);
+        m_data.emplace_back();
+    }
+    return it->second;
+}
+
+void Graph::reserve(std::size_t nodes) {
+    m_index.reserve(nodes);
+    m_nodes.reserve(nodes);
+    m_data.reserve(nodes);
+}
+
 bool Graph::add_edge_one_way(Edge&& e, Distance d) noexcept {
     auto[from, to] = e;
     if (from == to) { return false; }
-    return m_data[from].insert({ to, d }).second;
+    if (frozen()) { thaw(); }
+    auto u = intern(from), v = intern(to);
+    for (const auto&[w, _]: m_data[u]) {
+        if (w == v) { return false; }
+    }
+    m_data[u].emplace_back(v, d);
+    return true;
 }
 
 bool Graph::add_edge_two_way(Edge&& e, Distance d) noexcept {
     auto[from, to] = e;
     if (from == to) { return false; }
-    return m_data[from].insert({ to, d }).second && m_data[to].insert({ from, d }).second;
+    return add_edge_one_way({ from, to }, d) && add_edge_one_way({ to, from }, d);
+}
+
+void Graph::freeze() {
+    if (frozen()) { return; }
+
+    m_offsets.assign(m_nodes.size() + 1, 0);
+    m_targets.clear();
+    m_weights.clear();
+    for (Index v = 0; v < m_nodes.size(); v += 1) {
+        // Keep each row sorted by target for cache-friendly relaxations.
+        auto& row = m_data[v];
+        std::sort(row.begin(), row.end());
+        for (const auto&[to, d]: row) {
+            m_targets.push_back(to);
+            m_weights.push_back(d);
+        }
+        m_offsets[v + 1] = m_targets.size();
+    }
+
+    m_data.clear();
+    m_data.shrink_to_fit();
+    m_frozen = true;
+    transpose();
+}
+
+void Graph::transpose() {
+    m_reverse_offsets.assign(m_nodes.size() + 1, 0);
+    for (auto to: m_targets) { m_reverse_offsets[to + 1] += 1; }
+    for (Index v = 0; v < m_nodes.size(); v += 1) {
+        m_reverse_offsets[v + 1] += m_reverse_offsets[v];
+    }
+
+    // Sources come out sorted, since rows are visited in order.
+    m_sources.resize(m_targets.size());
+    m_reverse_weights.resize(m_targets.size());
+    auto position = m_reverse_offsets;
+    for (Index v = 0; v < m_nodes.size(); v += 1) {
+        for (const auto&[to, d]: edges(v)) {
+            m_sources[position[to]] = v;
+            m_reverse_weights[position[to]] = d;
+            position[to] += 1;
+        }
+    }
+}
+
+void Graph::thaw() {
+    m_data.assign(m_nodes.size(), {});
+    for (Index v = 0; v < m_nodes.size(); v += 1) {
+        m_data[v].assign(edges(v).begin(), edges(v).end());
+    }
+    m_offsets.assign(1, 0);
+    m_targets.clear();
+    m_weights.clear();
+    m_reverse_offsets.assign(1, 0);
+    m_sources.clear();
+    m_reverse_weights.clear();
+    m_frozen = false;
+}
+
+auto Graph::weight(Index from, Index to) const -> Distance {
+    for (const auto&[v, d]: edges(from)) {
+        if (v == to) { return d; }
+    }
+    return INF;
+}
+
+template<typename Queue>
+auto Graph::dijkstra(Index s, const std::vector<Index>& targets, Distance cutoff) const
+-> std::pair<ShortestPaths, Trail> {
+    Workspace<Queue> workspace { size() };
+    dijkstra(s, workspace, targets, cutoff);
+    return { workspace.distances(size()), workspace.trail(size()) };
+}
+
+template<typename Queue>
+void Graph::dijkstra(Index s, Workspace<Queue>& workspace, const std::vector<Index>& targets,
+                     Distance cutoff) const {
+    search(s, workspace, targets, cutoff, Direction::Forward);
+}
+
+auto Graph::reverse_dijkstra(Index t, const std::vector<Index>& sources, Distance cutoff) const
+-> std::pair<ShortestPaths, Trail> {
+    Workspace<> workspace { size() };
+    reverse_dijkstra(t, workspace, sources, cutoff);
+    return { workspace.distances(size()), workspace.trail(size()) };
+}
+
+void Graph::reverse_dijkstra(Index t, Workspace<>& workspace, const std::vector<Index>& sources,
+                             Distance cutoff) const {
+    search(t, workspace, sources, cutoff, Direction::Backward);
+}
+
+template<typename Queue>
+void Graph::search(Index s, Workspace<Queue>& workspace, const std::vector<Index>& targets,
+                   Distance cutoff, Direction direction) const {
+    workspace.fit(size());
+    workspace.reset();
+    auto& queue = workspace.queue();
+
+    // Targets yet to be settled.
+    size_t remaining = 0;
+    for (auto t: targets) {
+        if (!workspace.marked(t)) { workspace.mark(t), remaining += 1; }
+    }
+
+    workspace.set(s, 0, NONE);
+    queue.push(s, 0);
+    while (!queue.empty()) {
+        auto[d, v] = queue.pop();
+        if (d > workspace.distance(v)) { continue; }
+        if (remaining > 0 && workspace.marked(v)) {
+            workspace.unmark(v);
+            if (--remaining == 0) { break; }
+        }
+        for (const auto&[to, length]: edges(v, direction)) {
+            if (d + length < workspace.distance(to) && d + length <= cutoff) {
+                workspace.set(to, d + length, v);
+                queue.push(to, d + length);
+            }
+        }
+    }
+    queue.clear();
+}
+
+template auto Graph::dijkstra<QuaternaryHeap>(Index, const std::vector<Index>&, Distance) const
+-> std::pair<ShortestPaths, Trail>;
+template auto Graph::dijkstra<LazyBinaryHeap>(Index, const std::vector<Index>&, Distance) const
+-> std::pair<ShortestPaths, Trail>;
+template auto Graph::dijkstra<RadixHeap>(Index, const std::vector<Index>&, Distance) const
+-> std::pair<ShortestPaths, Trail>;
+template void Graph::dijkstra(Index, Workspace<QuaternaryHeap>&, const std::vector<Index>&,
+                              Distance) const;
+template void Graph::dijkstra(Index, Workspace<LazyBinaryHeap>&, const std::vector<Index>&,
+                              Distance) const;
+template void Graph::dijkstra(Index, Workspace<RadixHeap>&, const std::vector<Index>&,
+                              Distance) const;
+
+auto Graph::within(Index s, Distance radius, Workspace<>& workspace,
+                   Direction direction) const -> std::vector<std::pair<Index, Distance>> {
+    workspace.fit(size());
+    workspace.reset();
+    auto& queue = workspace.queue();
+    std::vector<std::pair<Index, Distance>> result;
+
+    workspace.set(s, 0, NONE);
+    queue.push(s, 0);
+    while (!queue.empty()) {
+        auto[d, v] = queue.pop();
+        result.emplace_back(v, d);
+        for (const auto&[to, length]: edges(v, direction)) {
+            if (d + length < workspace.distance(to) && d + length <= radius) {
+                workspace.set(to, d + length, v);
+                queue.push(to, d + length);
+            }
+        }
+    }
+    return result;
 }
 
-auto Graph::dijkstra(Node s) const -> std::pair<ShortestPaths, Trail> {
-    constexpr auto INF = std::numeric_limits<double>::max();
+auto Graph::voronoi(const std::vector<Index>& sources, Direction direction) const
+-> std::pair<ShortestPaths, std::vector<Index>> {
+    ShortestPaths distances(size(), INF);
+    std::vector<Index> owners(size(), NONE);
+    QuaternaryHeap queue { size() };
 
-    std::unordered_map<Node, Distance> distances;
-    std::set<std::pair<Distance, Node>> set;
-    std::unordered_map<Node, Node> previous;
+    // Equal distance from an earlier source takes a node over, ties don't depend on settling order.
+    const auto claim = [&](Index v, Distance d, Index owner) {
+        if (d < distances[v] || (d == distances[v] && owner < owners[v])) {
+            distances[v] = d, owners[v] = owner;
+            queue.push(v, d);
+        }
+    };
+    for (Index i = 0; i < sources.size(); i += 1) { claim(sources[i], 0, i); }
+    while (!queue.empty()) {
+        auto[d, v] = queue.pop();
+        for (const auto&[to, length]: edges(v, direction)) {
+            claim(to, d + length, owners[v]);
+        }
+    }
+
+    return { distances, owners };
+}
+
+namespace {
+/**
+ * Relax an edge for every lane: target = min(target, source + weight).
+ *
+ * @return Smallest of the improved distances, INF if none is.
+ */
+Distance relax(Distance* target, const Distance* source, Distance weight) {
+#ifdef __SSE2__
+    static_assert(Graph::LANES % 2 == 0);
+    const auto w = _mm_set1_pd(weight);
+    const auto inf = _mm_set1_pd(Graph::INF);
+    auto best = inf;
+    for (std::size_t k = 0; k < Graph::LANES; k += 2) {
+        const auto candidate = _mm_add_pd(_mm_loadu_pd(source + k), w);
+        const auto current = _mm_loadu_pd(target + k);
+        const auto improved = _mm_cmplt_pd(candidate, current);
+        best = _mm_min_pd(best, _mm_or_pd(_mm_and_pd(improved, candidate),
+                                          _mm_andnot_pd(improved, inf)));
+        _mm_storeu_pd(target + k, _mm_min_pd(candidate, current));
+    }
+    return std::min(_mm_cvtsd_f64(best), _mm_cvtsd_f64(_mm_unpackhi_pd(best, best)));
+#else
+    auto best = Graph::INF;
+    for (std::size_t k = 0; k < Graph::LANES; k += 1) {
+        const auto candidate = source[k] + weight;
+        if (candidate < target[k]) {
+            target[k] = candidate;
+            best = std::min(best, candidate);
+        }
+    }
+    return best;
+#endif
+}
+} // namespace
+
+auto Graph::batched_dijkstra(const std::vector<Index>& sources, Distance delta) const
+-> std::vector<ShortestPaths> {
+    if (delta <= 0) { delta = BUCKET * mean_weight(); }
+    std::vector<ShortestPaths> result(sources.size());
+    std::vector<Distance> labels;
+    // Key a node is queued with, INF if it is not; the heap only takes decreasing keys.
+    ShortestPaths keys(size(), INF);
+    QuaternaryHeap queue { size() };
+
+    const auto order = z_order(sources);
+    for (std::size_t first = 0; first < sources.size(); first += LANES) {
+        const auto count = std::min(LANES, sources.size() - first);
+        labels.assign(size() * LANES, INF);
+        for (std::size_t k = 0; k < count; k += 1) {
+            const auto s = sources[order[first + k]];
+            labels[std::size_t { s } * LANES + k] = 0;
+            keys[s] = 0;
+            queue.push(s, 0);
+        }
+
+        // Node improved again after its scan is queued again, labels end up exact regardless.
+        while (!queue.empty()) {
+            const auto v = queue.pop().second;
+            keys[v] = INF;
+            const auto* source = labels.data() + std::size_t { v } * LANES;
+            for (const auto&[to, length]: edges(v)) {
+                auto key = relax(labels.data() + std::size_t { to } * LANES, source, length);
+                if (key < INF) { key = std::floor(key / delta) * delta; }
+                if (key < keys[to]) {
+                    keys[to] = key;
+                    queue.push(to, key);
+                }
+            }
+        }
+
+        for (std::size_t k = 0; k < count; k += 1) {
+            auto& distances = result[order[first + k]];
+            distances.resize(size());
+            for (Index v = 0; v < size(); v += 1) {
+                distances[v] = labels[std::size_t { v } * LANES + k];
+            }
+        }
+    }
+    return result;
+}
+
+auto Graph::z_order(const std::vector<Index>& nodes) const -> std::vector<std::size_t> {
+    std::vector<std::size_t> order(nodes.size());
+    std::iota(order.begin(), order.end(), 0);
+    if (nodes.empty()) { return order; }
+
+    Angle south = m_nodes.latitude(nodes[0]), north = south;
+    Angle west = m_nodes.longitude(nodes[0]), east = west;
+    for (auto v: nodes) {
+        const auto lat = m_nodes.latitude(v), lon = m_nodes.longitude(v);
+        south = std::min(south, lat), north = std::max(north, lat);
+        west = std::min(west, lon), east = std::max(east, lon);
+    }
+    // 16 bits of each coordinate interleaved.
+    const auto cell = [](Angle x, Angle low, Angle high) -> std::uint64_t {
+        if (high <= low) { return 0; }
+        const auto y = static_cast<std::uint64_t>(
+            static_cast<double>(std::int64_t { x } - low) / (std::int64_t { high } - low) * 0xffff);
+        std::uint64_t result = 0;
+        for (unsigned bit = 0; bit < 16; bit += 1) { result |= (y >> bit & 1) << 2 * bit; }
+        return result;
+    };
+    std::vector<std::uint64_t> codes(nodes.size());
+    for (std::size_t i = 0; i < nodes.size(); i += 1) {
+        codes[i] = cell(m_nodes.latitude(nodes[i]), south, north) << 1
+                   | cell(m_nodes.longitude(nodes[i]), west, east);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](auto i, auto j) {
+        return codes[i] < codes[j];
+    });
+    return order;
+}
+
+Distance Graph::mean_weight() const {
+    const auto total = std::accumulate(m_weights.cbegin(), m_weights.cend(), Distance { 0 });
+    return total > 0 ? total / static_cast<Distance>(m_weights.size()) : 1;
+}
+
+auto Graph::delta_stepping(Index s, Scheduler& scheduler, Distance delta) const
+-> std::pair<ShortestPaths, Trail> {
+    constexpr std::size_t GRAIN = 256;
+    constexpr auto NEVER = std::numeric_limits<std::size_t>::max();
 
-    for (const auto&[node, _]: nodes()) { distances[node] = INF; }
+    if (delta <= 0) { delta = mean_weight(); }
+
+    // Distances are read concurrently; updates of a node go under its spinlock with the trail.
+    std::vector<std::atomic<Distance>> distances(size());
+    std::vector<std::atomic<bool>> locks(size());
+    for (Index v = 0; v < size(); v += 1) {
+        distances[v].store(INF, std::memory_order_relaxed);
+        locks[v].store(false, std::memory_order_relaxed);
+    }
+    Trail previous(size(), NONE);
+
+    std::vector<std::vector<Index>> buckets;
+    const auto bucket = [&](Index v) {
+        return static_cast<std::size_t>(distances[v].load(std::memory_order_relaxed) / delta);
+    };
+    const auto place = [&](Index v) {
+        const auto i = bucket(v);
+        if (i >= buckets.size()) { buckets.resize(i + 1); }
+        buckets[i].push_back(v);
+    };
+
+    // Each chunk collects the nodes it improved, they are bucketed once the phase is over.
+    std::vector<std::vector<Index>> improved;
+    const auto relax = [&](const std::vector<Index>& nodes, bool light) {
+        improved.resize((nodes.size() + GRAIN - 1) / GRAIN);
+        for (auto& chunk: improved) { chunk.clear(); }
+        scheduler.parallel_for(nodes.size(), GRAIN, [&](std::size_t begin, std::size_t end) {
+            auto& out = improved[begin / GRAIN];
+            for (auto k = begin; k < end; k += 1) {
+                const auto v = nodes[k];
+                const auto d = distances[v].load(std::memory_order_relaxed);
+                for (const auto&[to, length]: edges(v)) {
+                    if ((length <= delta) != light) { continue; }
+                    if (d + length >= distances[to].load(std::memory_order_relaxed)) { continue; }
+                    while (locks[to].exchange(true, std::memory_order_acquire)) {}
+                    const auto better = d + length < distances[to].load(std::memory_order_relaxed);
+                    if (better) {
+                        distances[to].store(d + length, std::memory_order_relaxed);
+                        previous[to] = v;
+                    }
+                    locks[to].store(false, std::memory_order_release);
+                    if (better) { out.push_back(to); }
+                }
+            }
+        });
+        for (const auto& chunk: improved) {
+            for (auto v: chunk) { place(v); }
+        }
+    };
+
+    distances[s].store(0, std::memory_order_relaxed);
+    place(s);
+
+    // Phase stamps drop duplicates and entries left behind in an older bucket.
+    std::vector<std::size_t> phase(size(), NEVER), settled_in(size(), NEVER);
+    std::size_t phases = 0;
+    std::vector<Index> frontier, settled;
+    for (std::size_t i = 0; i < buckets.size(); i += 1) {
+        settled.clear();
+        while (!buckets[i].empty()) {
+            frontier.clear();
+            for (auto v: buckets[i]) {
+                if (bucket(v) != i || phase[v] == phases) { continue; }
+                phase[v] = phases;
+                frontier.push_back(v);
+                if (settled_in[v] != i) { settled_in[v] = i, settled.push_back(v); }
+            }
+            buckets[i].clear();
+            phases += 1;
+            relax(frontier, true);
+        }
+        relax(settled, false);
+    }
+
+    ShortestPaths result(size());
+    for (Index v = 0; v < size(); v += 1) { result[v] = distances[v].load(); }
+    return { result, previous };
+}
+
+auto Graph::bidirectional(Index s, Index t) const -> std::pair<Distance, Route> {
+    ShortestPaths forward(size(), INF), backward(size(), INF);
+    Trail previous(size(), NONE), next(size(), NONE);
+    QuaternaryHeap forward_queue { size() }, backward_queue { size() };
+
+    // Best path found so far goes through the edge (meet_from, meet_to).
+    Distance best = s == t ? 0 : INF;
+    Index meet_from = s, meet_to = s;
+
+    forward[s] = 0, backward[t] = 0;
+    forward_queue.push(s, 0);
+    backward_queue.push(t, 0);
+    while (!forward_queue.empty() && !backward_queue.empty()
+           && forward_queue.top() + backward_queue.top() < best) {
+        if (forward_queue.top() <= backward_queue.top()) {
+            auto[d, v] = forward_queue.pop();
+            for (const auto&[to, length]: edges(v)) {
+                if (d + length < forward[to]) {
+                    forward[to] = d + length;
+                    previous[to] = v;
+                    forward_queue.push(to, forward[to]);
+                }
+                if (backward[to] < INF && d + length + backward[to] < best) {
+                    best = d + length + backward[to];
+                    meet_from = v, meet_to = to;
+                }
+            }
+        } else {
+            auto[d, v] = backward_queue.pop();
+            for (const auto&[from, length]: incoming(v)) {
+                if (d + length < backward[from]) {
+                    backward[from] = d + length;
+                    next[from] = v;
+                    backward_queue.push(from, backward[from]);
+                }
+                if (forward[from] < INF && d + length + forward[from] < best) {
+                    best = d + length + forward[from];
+                    meet_from = from, meet_to = v;
+                }
+            }
+        }
+    }
+
+    Route route;
+    if (best == INF) { return { best, route }; }
+    for (auto v = meet_from; v != NONE; v = previous[v]) { route.push_back(v); }
+    std::reverse(route.begin(), route.end());
+    if (meet_to != meet_from) {
+        for (auto v = meet_to; v != NONE; v = next[v]) { route.push_back(v); }
+    }
+    return { best, route };
+}
+
+template<typename Potential>
+auto Graph::astar(Index s, const std::vector<Index>& targets, const Potential& potential,
+                  Distance cutoff) const -> std::pair<ShortestPaths, Trail> {
+    ShortestPaths distances(size(), INF);
+    Trail previous(size(), NONE);
+    QuaternaryHeap queue { size() };
+
+    // Potentials are evaluated once per reached node.
+    std::vector<Distance> bounds(size(), INF);
+    std::vector<bool> pending(size(), false);
+    size_t remaining = 0;
+    for (auto t: targets) {
+        if (!pending[t]) { pending[t] = true, remaining += 1; }
+    }
+    if (remaining == 0) { return { distances, previous }; }
 
     distances[s] = 0;
-    set.insert({ distances[s], s });
-    while (!set.empty()) {
-        auto[_, v] = *set.begin();
-        set.erase(set.begin());
-        for (const auto& u: nodes().at(v)) {
-            auto[to, length] = u;
+    bounds[s] = potential(s);
+    queue.push(s, bounds[s]);
+    while (!queue.empty()) {
+        auto[_, v] = queue.pop();
+        if (pending[v]) {
+            pending[v] = false, remaining -= 1;
+            if (remaining == 0) { break; }
+        }
+        for (const auto&[to, length]: edges(v)) {
             if (distances[v] + length < distances[to]) {
-                set.erase({ distances[to], to });
+                if (bounds[to] == INF) { bounds[to] = potential(to); }
+                if (distances[v] + length + bounds[to] > cutoff) { continue; }
                 distances[to] = distances[v] + length;
                 previous[to] = v;
-                set.insert({ distances[to], to });
+                queue.push(to, distances[to] + bounds[to]);
             }
         }
     }
 
     return { distances, previous };
 }
+
+template auto Graph::astar(Index, const std::vector<Index>&, const HaversinePotential&,
+                           Distance) const -> std::pair<ShortestPaths, Trail>;
+template auto Graph::astar(Index, const std::vector<Index>&, const EquirectangularPotential&,
+                           Distance) const -> std::pair<ShortestPaths, Trail>;
+template auto Graph::astar(Index, const std::vector<Index>&, const LandmarkPotential&,
+                           Distance) const -> std::pair<ShortestPaths, Trail>;
 } // namespace graph
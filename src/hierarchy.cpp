@@ -0,0 +1,443 @@
+#include "hierarchy.hpp"
+
+#include <queue>
+#include <algorithm>
+#include <functional>
+
+#include <boost/serialization/vector.hpp>
+
+#include "heap.hpp"
+
+namespace graphs {
+bool Hierarchy::serialize(const fs::path& filename) const {
+    auto cname = filename;
+    cname.concat("-ch.dmp");
+    std::ofstream binary { cname, std::ios::out | std::ios::binary };
+    boost::archive::binary_oarchive archive { binary, boost::archive::no_header };
+    archive << m_fingerprint << m_rank << m_arcs << m_up << m_down;
+    return true;
+}
+
+bool Hierarchy::deserialize(const fs::path& filename, std::uint64_t fingerprint) {
+    auto cname = filename;
+    cname.concat("-ch.dmp");
+    if (!std::filesystem::exists(cname)) { return false; }
+    std::ifstream binary { cname, std::ios::binary };
+    boost::archive::binary_iarchive archive { binary, boost::archive::no_header };
+    archive >> m_fingerprint;
+    if (m_fingerprint != fingerprint) {
+        *this = Hierarchy {};
+        return false;
+    }
+    archive >> m_rank >> m_arcs >> m_up >> m_down;
+    return true;
+}
+} // namespace graphs
+
+namespace graphs {
+namespace {
+using Index = Graph::Index;
+
+/**
+ * Edge of the remaining (not yet contracted) graph.
+ */
+struct DynamicEdge {
+    Index node;
+    Distance weight;
+    Index arc;
+};
+
+using DynamicEdges = std::vector<DynamicEdge>;
+
+/**
+ * State of the contraction: remaining graph, produced arcs and witness search workspace.
+ */
+struct Contraction {
+    /**
+     * Witness searches give up after settling that many nodes and keep the shortcut.
+     * Priorities are only estimates, so simulated contractions search less.
+     */
+    static constexpr size_t SETTLE_LIMIT = 500;
+    static constexpr size_t SIMULATION_SETTLE_LIMIT = 50;
+
+    explicit Contraction(const Graph& graph)
+        : out(graph.size())
+        , in(graph.size())
+        , contracted(graph.size(), false)
+        , neighbours(graph.size(), 0)
+        , levels(graph.size(), 0)
+        , priorities(graph.size(), 0)
+        , distances(graph.size(), Graph::INF)
+        , target(graph.size(), false)
+        , queue(graph.size()) {
+        for (Index v = 0; v < graph.size(); v += 1) {
+            for (const auto&[to, d]: graph.edges(v)) {
+                const auto arc = static_cast<Index>(arcs.size());
+                arcs.push_back({ v, to, d, Graph::NONE, Graph::NONE });
+                out[v].push_back({ to, d, arc });
+                in[to].push_back({ v, d, arc });
+            }
+        }
+    }
+
+    /**
+     * Local Dijkstra from the source avoiding the node being contracted.
+     * Stops once all of its other out-neighbours are settled.
+     */
+    void witness(Index source, Index avoid, Distance limit, size_t settle_limit) {
+        for (auto v: touched) { distances[v] = Graph::INF; }
+        touched.clear();
+
+        size_t remaining = 0;
+        for (const auto& o: out[avoid]) {
+            if (o.node != source) { target[o.node] = true, remaining += 1; }
+        }
+
+        distances[source] = 0;
+        touched.push_back(source);
+        queue.push(source, 0);
+        size_t settled = 0;
+        while (!queue.empty()) {
+            auto[d, v] = queue.pop();
+            if (d > limit || ++settled > settle_limit) { break; }
+            if (target[v]) {
+                target[v] = false;
+                if (--remaining == 0) { break; }
+            }
+            for (const auto& e: out[v]) {
+                if (e.node == avoid || d + e.weight >= distances[e.node]) { continue; }
+                if (distances[e.node] == Graph::INF) { touched.push_back(e.node); }
+                distances[e.node] = d + e.weight;
+                queue.push(e.node, distances[e.node]);
+            }
+        }
+        queue.clear();
+        for (const auto& o: out[avoid]) { target[o.node] = false; }
+    }
+
+    /**
+     * Call emit(from, to, weight, first arc, second arc) for each shortcut
+     * that contraction of the node requires.
+     */
+    template<typename F>
+    void shortcuts(Index v, size_t settle_limit, F&& emit) {
+        for (const auto& i: in[v]) {
+            Distance limit = -1;
+            for (const auto& o: out[v]) {
+                if (o.node != i.node) { limit = std::max(limit, i.weight + o.weight); }
+            }
+            if (limit < 0) { continue; }
+
+            witness(i.node, v, limit, settle_limit);
+            for (const auto& o: out[v]) {
+                if (o.node == i.node) { continue; }
+                if (distances[o.node] > i.weight + o.weight) {
+                    emit(i.node, o.node, i.weight + o.weight, i.arc, o.arc);
+                }
+            }
+        }
+    }
+
+    /**
+     * Doubled edge difference plus the number of contracted neighbours and the level
+     * (depth in the hierarchy) of the node; the latter two spread contraction uniformly
+     * over the graph and keep the search spaces shallow.
+     */
+    int priority(Index v) {
+        int added = 0;
+        shortcuts(v, SIMULATION_SETTLE_LIMIT, [&](auto...) { added += 1; });
+        const auto removed = static_cast<int>(in[v].size() + out[v].size());
+        return 2 * (added - removed) + neighbours[v] + levels[v];
+    }
+
+    void add_shortcut(Index from, Index to, Distance weight, Index first, Index second) {
+        auto it = std::find_if(out[from].begin(), out[from].end(),
+                               [&](const auto& e) { return e.node == to; });
+        if (it != out[from].end() && it->weight <= weight) { return; }
+
+        const auto arc = static_cast<Index>(arcs.size());
+        arcs.push_back({ from, to, weight, first, second });
+        if (it != out[from].end()) {
+            *it = { to, weight, arc };
+            *std::find_if(in[to].begin(), in[to].end(),
+                          [&](const auto& e) { return e.node == from; }) = { from, weight, arc };
+        } else {
+            out[from].push_back({ to, weight, arc });
+            in[to].push_back({ from, weight, arc });
+        }
+    }
+
+    /**
+     * Remove node from the remaining graph, its edges are the final hierarchy arcs.
+     */
+    void contract(Index v) {
+        std::vector<std::tuple<Index, Index, Distance, Index, Index>> added;
+        shortcuts(v, SETTLE_LIMIT,
+                  [&](Index from, Index to, Distance weight, Index first, Index second) {
+                      added.emplace_back(from, to, weight, first, second);
+                  });
+        for (const auto&[from, to, weight, first, second]: added) {
+            add_shortcut(from, to, weight, first, second);
+        }
+
+        const auto erase = [v](DynamicEdges& edges) {
+            edges.erase(std::remove_if(edges.begin(), edges.end(),
+                                       [v](const auto& e) { return e.node == v; }), edges.end());
+        };
+        for (const auto& o: out[v]) {
+            erase(in[o.node]);
+            neighbours[o.node] += 1;
+            levels[o.node] = std::max(levels[o.node], levels[v] + 1);
+        }
+        for (const auto& i: in[v]) {
+            erase(out[i.node]);
+            neighbours[i.node] += 1;
+            levels[i.node] = std::max(levels[i.node], levels[v] + 1);
+        }
+        contracted[v] = true;
+    }
+
+    std::vector<DynamicEdges> out, in;
+    std::vector<Hierarchy::Arc> arcs {};
+    std::vector<bool> contracted;
+    std::vector<int> neighbours;
+    std::vector<int> levels;
+    std::vector<int> priorities;
+
+    ShortestPaths distances;
+    std::vector<bool> target;
+    std::vector<Index> touched {};
+    QuaternaryHeap queue;
+};
+
+template<typename Rows>
+auto pack(const Rows& rows) -> Hierarchy::Adjacency {
+    Hierarchy::Adjacency result;
+    result.m_offsets.reserve(rows.size() + 1);
+    for (const auto& row: rows) {
+        for (const auto& e: row) { result.m_entries.push_back({ e.node, e.weight, e.arc }); }
+        result.m_offsets.push_back(result.m_entries.size());
+    }
+    return result;
+}
+
+/**
+ * Labels and queues of the searches from both ends of a query, INF and NONE outside of it.
+ * Only the nodes a query touched are reset after it, so its cost follows the search space.
+ */
+struct Labels {
+    void fit(size_t n) {
+        if (n <= forward.size()) { return; }
+        forward.resize(n, Graph::INF);
+        backward.resize(n, Graph::INF);
+        forward_arc.resize(n, Graph::NONE);
+        backward_arc.resize(n, Graph::NONE);
+        forward_queue = QuaternaryHeap { n };
+        backward_queue = QuaternaryHeap { n };
+    }
+
+    void clear() {
+        for (auto v: touched) {
+            forward[v] = backward[v] = Graph::INF;
+            forward_arc[v] = backward_arc[v] = Graph::NONE;
+        }
+        touched.clear();
+        forward_queue.clear();
+        backward_queue.clear();
+    }
+
+    ShortestPaths forward {}, backward {};
+    std::vector<Index> forward_arc {}, backward_arc {};
+    QuaternaryHeap forward_queue { 0 }, backward_queue { 0 };
+    std::vector<Index> touched {};
+};
+
+Labels& thread_labels(size_t n) {
+    thread_local Labels labels;
+    labels.fit(n);
+    return labels;
+}
+} // namespace
+
+Hierarchy::Hierarchy(const Graph& graph)
+    : m_fingerprint(graph.fingerprint())
+    , m_rank(graph.size(), Graph::NONE) {
+    Contraction state { graph };
+    std::vector<DynamicEdges> up(graph.size()), down(graph.size());
+
+    // Queue holds outdated entries too, only the one with the current priority counts.
+    using Item = std::pair<int, Index>;
+    std::priority_queue<Item, std::vector<Item>, std::greater<>> order;
+    const auto update = [&](Index v) {
+        state.priorities[v] = state.priority(v);
+        order.emplace(state.priorities[v], v);
+    };
+    for (Index v = 0; v < graph.size(); v += 1) { update(v); }
+
+    Index rank = 0;
+    while (!order.empty()) {
+        auto[priority, v] = order.top();
+        order.pop();
+        if (state.contracted[v] || priority != state.priorities[v]) { continue; }
+
+        // Lazy update: priority may have grown since the node was queued.
+        const auto current = state.priority(v);
+        if (!order.empty() && current > order.top().first) {
+            state.priorities[v] = current;
+            order.emplace(current, v);
+            continue;
+        }
+
+        up[v] = state.out[v];
+        down[v] = state.in[v];
+        state.contract(v);
+        m_rank[v] = rank++;
+
+        for (const auto& e: up[v]) { update(e.node); }
+        for (const auto& e: down[v]) { update(e.node); }
+    }
+
+    m_arcs = std::move(state.arcs);
+    m_up = pack(up);
+    m_down = pack(down);
+}
+
+auto Hierarchy::query(Index s, Index t) const -> std::pair<Distance, Graph::Route> {
+    constexpr auto INF = Graph::INF;
+
+    auto& labels = thread_labels(size());
+    auto&[forward, backward, forward_arc, backward_arc, forward_queue, backward_queue, touched] =
+        labels;
+
+    Distance best = INF;
+    Index meet = Graph::NONE;
+
+    forward[s] = 0, backward[t] = 0;
+    touched.push_back(s);
+    touched.push_back(t);
+    forward_queue.push(s, 0);
+    backward_queue.push(t, 0);
+    while (true) {
+        const auto forward_open = !forward_queue.empty() && forward_queue.top() < best;
+        const auto backward_open = !backward_queue.empty() && backward_queue.top() < best;
+        if (!forward_open && !backward_open) { break; }
+
+        if (forward_open && (!backward_open || forward_queue.top() <= backward_queue.top())) {
+            auto[d, v] = forward_queue.pop();
+            if (backward[v] < INF && d + backward[v] < best) { best = d + backward[v], meet = v; }
+            for (const auto& e: m_up[v]) {
+                if (d + e.weight < forward[e.node]) {
+                    if (forward[e.node] == INF) { touched.push_back(e.node); }
+                    forward[e.node] = d + e.weight;
+                    forward_arc[e.node] = e.arc;
+                    forward_queue.push(e.node, forward[e.node]);
+                }
+            }
+        } else {
+            auto[d, v] = backward_queue.pop();
+            if (forward[v] < INF && d + forward[v] < best) { best = d + forward[v], meet = v; }
+            for (const auto& e: m_down[v]) {
+                if (d + e.weight < backward[e.node]) {
+                    if (backward[e.node] == INF) { touched.push_back(e.node); }
+                    backward[e.node] = d + e.weight;
+                    backward_arc[e.node] = e.arc;
+                    backward_queue.push(e.node, backward[e.node]);
+                }
+            }
+        }
+    }
+
+    Graph::Route route;
+    if (meet == Graph::NONE) {
+        labels.clear();
+        return { INF, route };
+    }
+
+    // Arcs from the source up to the meeting node and from it down to the target.
+    std::vector<Index> arcs;
+    for (auto v = meet; forward_arc[v] != Graph::NONE; v = m_arcs[forward_arc[v]].from) {
+        arcs.push_back(forward_arc[v]);
+    }
+    std::reverse(arcs.begin(), arcs.end());
+    for (auto v = meet; backward_arc[v] != Graph::NONE; v = m_arcs[backward_arc[v]].to) {
+        arcs.push_back(backward_arc[v]);
+    }
+    labels.clear();
+
+    route.push_back(s);
+    for (auto arc: arcs) { unpack(arc, route); }
+    return { best, route };
+}
+
+template<typename F>
+void Hierarchy::upward(Index s, const Adjacency& arcs, ShortestPaths& distances,
+                       std::vector<Index>& touched, QuaternaryHeap& queue, F&& settle) const {
+    distances[s] = 0;
+    touched.push_back(s);
+    queue.push(s, 0);
+    while (!queue.empty()) {
+        auto[d, v] = queue.pop();
+        settle(v, d);
+        for (const auto& e: arcs[v]) {
+            if (d + e.weight >= distances[e.node]) { continue; }
+            if (distances[e.node] == Graph::INF) { touched.push_back(e.node); }
+            distances[e.node] = d + e.weight;
+            queue.push(e.node, distances[e.node]);
+        }
+    }
+    for (auto v: touched) { distances[v] = Graph::INF; }
+    touched.clear();
+}
+
+auto Hierarchy::many_to_many(const std::vector<Index>& sources,
+                             const std::vector<Index>& targets) const
+-> std::vector<ShortestPaths> {
+    struct Entry {
+        Index target;
+        Distance distance;
+    };
+
+    ShortestPaths distances(size(), Graph::INF);
+    std::vector<Index> touched;
+    // Every search empties the queue, which leaves its positions reset for the next one.
+    QuaternaryHeap queue { size() };
+
+    // Backward searches, bucket entries are grouped by node in CSR layout afterwards.
+    std::vector<std::pair<Index, Entry>> entries;
+    for (Index j = 0; j < targets.size(); j += 1) {
+        upward(targets[j], m_down, distances, touched, queue,
+               [&](Index v, Distance d) { entries.push_back({ v, { j, d }}); });
+    }
+    std::vector<Index> offsets(size() + 1, 0);
+    for (const auto& entry: entries) { offsets[entry.first + 1] += 1; }
+    for (size_t v = 0; v < size(); v += 1) { offsets[v + 1] += offsets[v]; }
+    std::vector<Entry> buckets(entries.size());
+    {
+        auto position = offsets;
+        for (const auto&[v, entry]: entries) { buckets[position[v]++] = entry; }
+    }
+    entries = {};
+
+    std::vector<ShortestPaths> result(sources.size(), ShortestPaths(targets.size(), Graph::INF));
+    for (size_t i = 0; i < sources.size(); i += 1) {
+        auto& row = result[i];
+        upward(sources[i], m_up, distances, touched, queue, [&](Index v, Distance d) {
+            for (auto k = offsets[v]; k < offsets[v + 1]; k += 1) {
+                const auto&[j, distance] = buckets[k];
+                row[j] = std::min(row[j], d + distance);
+            }
+        });
+    }
+    return result;
+}
+
+void Hierarchy::unpack(Index arc, Graph::Route& route) const {
+    const auto& a = m_arcs[arc];
+    if (a.shortcut()) {
+        unpack(a.first, route);
+        unpack(a.second, route);
+    } else {
+        route.push_back(a.to);
+    }
+}
+} // namespace graphs
@@ -0,0 +1,156 @@
+#include "hull.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace graphs {
+namespace {
+constexpr double R = 6'371'000;
+constexpr std::size_t NONE = std::numeric_limits<std::size_t>::max();
+
+struct Point {
+    double x, y;
+};
+
+double cross(const Point& o, const Point& a, const Point& b) {
+    return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+double squared(const Point& a, const Point& b) {
+    return (a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y);
+}
+
+/**
+ * Squared distance from p to the segment ab.
+ */
+double squared(const Point& p, const Point& a, const Point& b) {
+    const auto dx = b.x - a.x, dy = b.y - a.y;
+    const auto length = dx * dx + dy * dy;
+    if (length == 0) { return squared(p, a); }
+    const auto t = std::clamp(((p.x - a.x) * dx + (p.y - a.y) * dy) / length, 0.0, 1.0);
+    return squared(p, { a.x + t * dx, a.y + t * dy });
+}
+
+/**
+ * Whether segments ab and cd cross at a point inside both of them.
+ */
+bool crossing(const Point& a, const Point& b, const Point& c, const Point& d) {
+    const auto abc = cross(a, b, c), abd = cross(a, b, d);
+    const auto cda = cross(c, d, a), cdb = cross(c, d, b);
+    return ((abc > 0 && abd < 0) || (abc < 0 && abd > 0))
+           && ((cda > 0 && cdb < 0) || (cda < 0 && cdb > 0));
+}
+
+/**
+ * Convex hull by the monotone chain, counterclockwise, points sorted by coordinates.
+ */
+auto convex_hull(const std::vector<Point>& points) -> std::vector<std::size_t> {
+    std::vector<std::size_t> hull(2 * points.size());
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < points.size(); i += 1) {
+        while (k >= 2 && cross(points[hull[k - 2]], points[hull[k - 1]], points[i]) <= 0) {
+            k -= 1;
+        }
+        hull[k++] = i;
+    }
+    for (std::size_t i = points.size() - 1, lower = k + 1; i-- > 0;) {
+        while (k >= lower && cross(points[hull[k - 2]], points[hull[k - 1]], points[i]) <= 0) {
+            k -= 1;
+        }
+        hull[k++] = i;
+    }
+    hull.resize(k - 1);
+    return hull;
+}
+} // namespace
+
+auto concave_hull(const Locations& locations, double concavity,
+                  Distance threshold) -> Locations {
+    // Scaling keeps the order, so sorting by longitude first sorts the projected points by x.
+    auto unique = locations;
+    const auto by_longitude = [](const Location& lhs, const Location& rhs) {
+        return std::pair { lhs.second, lhs.first } < std::pair { rhs.second, rhs.first };
+    };
+    std::sort(unique.begin(), unique.end(), by_longitude);
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+    if (unique.size() < 3) { return unique; }
+
+    // Local projection around the mean latitude, x grows to the east and y to the north.
+    std::int64_t latitude = 0;
+    for (const auto&[lat, _]: unique) { latitude += lat; }
+    const auto size = static_cast<std::int64_t>(unique.size());
+    const auto cos_phi = std::cos(radians(static_cast<Angle>(latitude / size)));
+    std::vector<Point> points;
+    points.reserve(unique.size());
+    for (const auto&[lat, lon]: unique) {
+        points.push_back({ R * radians(lon) * cos_phi, R * radians(lat) });
+    }
+
+    const auto hull = convex_hull(points);
+    if (hull.size() < 3) { return unique; }
+
+    // Boundary is a circular list over the points, NONE for the inner ones.
+    std::vector<std::size_t> next(points.size(), NONE), previous(points.size(), NONE);
+    std::vector<std::pair<std::size_t, std::size_t>> edges;
+    for (std::size_t i = 0; i < hull.size(); i += 1) {
+        const auto a = hull[i], b = hull[(i + 1) % hull.size()];
+        next[a] = b, previous[b] = a;
+        edges.emplace_back(a, b);
+    }
+
+    const auto simple = [&](std::size_t a, std::size_t p, std::size_t b) {
+        auto u = a;
+        do {
+            const auto v = next[u];
+            if (u != a && v != a && crossing(points[a], points[p], points[u], points[v])) {
+                return false;
+            }
+            if (u != a && u != b && crossing(points[p], points[b], points[u], points[v])) {
+                return false;
+            }
+            u = v;
+        } while (u != a);
+        return true;
+    };
+
+    while (!edges.empty()) {
+        const auto[a, b] = edges.back();
+        edges.pop_back();
+        if (next[a] != b) { continue; }
+        const auto length = squared(points[a], points[b]);
+        if (length < threshold * threshold) { continue; }
+
+        // Inner point closest to the edge, unless it is closer to one of the adjacent edges.
+        auto candidate = NONE;
+        auto best = std::numeric_limits<double>::max();
+        for (std::size_t p = 0; p < points.size(); p += 1) {
+            if (next[p] != NONE) { continue; }
+            const auto distance = squared(points[p], points[a], points[b]);
+            if (distance >= best
+                || distance >= squared(points[p], points[previous[a]], points[a])
+                || distance >= squared(points[p], points[b], points[next[b]])) {
+                continue;
+            }
+            candidate = p, best = distance;
+        }
+        if (candidate == NONE) { continue; }
+
+        const auto nearer = std::min(squared(points[candidate], points[a]),
+                                     squared(points[candidate], points[b]));
+        if (length <= nearer * concavity * concavity || !simple(a, candidate, b)) { continue; }
+
+        next[a] = candidate, previous[candidate] = a;
+        next[candidate] = b, previous[b] = candidate;
+        edges.emplace_back(candidate, b);
+        edges.emplace_back(a, candidate);
+    }
+
+    Locations result;
+    auto v = hull.front();
+    do {
+        result.push_back(unique[v]);
+        v = next[v];
+    } while (v != hull.front());
+    return result;
+}
+} // namespace graphs
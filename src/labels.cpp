@@ -0,0 +1,218 @@
+#include "labels.hpp"
+
+#include <algorithm>
+
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace graphs {
+namespace {
+using Index = Graph::Index;
+
+/*
+ * Flat layout: header of HEADER words (magic, nodes, forward and backward entries,
+ * fingerprint of the graph), then
+ * for each direction offsets (nodes + 1 words), hubs and distances, every array 8-aligned.
+ */
+constexpr std::uint64_t MAGIC = 0x4c424c4255484732; // "2GHUBLBL"
+constexpr std::size_t HEADER = 5;
+
+constexpr std::size_t aligned(std::size_t bytes) { return (bytes + 7) / 8 * 8; }
+
+constexpr std::size_t section(std::size_t nodes, std::size_t entries) {
+    return 8 * (nodes + 1) + aligned(sizeof(Index) * entries) + sizeof(Distance) * entries;
+}
+
+/**
+ * Label under construction.
+ */
+struct Builder {
+    std::vector<Index> hubs {};
+    std::vector<Distance> distances {};
+
+    [[nodiscard]] HubLabels::Label view() const {
+        return { hubs.data(), distances.data(), hubs.size() };
+    }
+};
+
+/**
+ * Label of v from the labels of its upper neighbours, pruned against the opposite labels.
+ */
+auto merge(Index v, Hierarchy::Adjacency::Row arcs, const std::vector<Builder>& labels,
+           const std::vector<Builder>& opposite, bool forward) -> Builder {
+    std::vector<std::pair<Index, Distance>> candidates { { v, 0 } };
+    for (const auto& e: arcs) {
+        const auto& upper = labels[e.node];
+        for (std::size_t i = 0; i < upper.hubs.size(); i += 1) {
+            candidates.emplace_back(upper.hubs[i], e.weight + upper.distances[i]);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    Builder result;
+    for (const auto&[hub, distance]: candidates) {
+        if (!result.hubs.empty() && result.hubs.back() == hub) { continue; }
+        result.hubs.push_back(hub);
+        result.distances.push_back(distance);
+    }
+
+    // Hub is redundant if the path to it is not the shortest one.
+    Builder pruned;
+    for (std::size_t i = 0; i < result.hubs.size(); i += 1) {
+        const auto hub = result.hubs[i];
+        if (hub != v) {
+            const auto other = opposite[hub].view();
+            const auto shortest = forward ? HubLabels::join(result.view(), other)
+                                          : HubLabels::join(other, result.view());
+            if (shortest < result.distances[i]) { continue; }
+        }
+        pruned.hubs.push_back(hub);
+        pruned.distances.push_back(result.distances[i]);
+    }
+    return pruned;
+}
+
+/**
+ * Write one direction into the buffer, returns the position past it.
+ */
+char* flatten(char* data, const std::vector<Builder>& labels) {
+    auto* offsets = reinterpret_cast<std::uint64_t*>(data);
+    offsets[0] = 0;
+    for (std::size_t v = 0; v < labels.size(); v += 1) {
+        offsets[v + 1] = offsets[v] + labels[v].hubs.size();
+    }
+    const auto entries = offsets[labels.size()];
+    auto* hubs = reinterpret_cast<Index*>(data + 8 * (labels.size() + 1));
+    auto* distances = reinterpret_cast<Distance*>(reinterpret_cast<char*>(hubs)
+                                                  + aligned(sizeof(Index) * entries));
+    for (std::size_t v = 0; v < labels.size(); v += 1) {
+        std::copy(labels[v].hubs.begin(), labels[v].hubs.end(), hubs + offsets[v]);
+        std::copy(labels[v].distances.begin(), labels[v].distances.end(),
+                  distances + offsets[v]);
+    }
+    return reinterpret_cast<char*>(distances + entries);
+}
+
+auto entries(const std::vector<Builder>& labels) -> std::size_t {
+    std::size_t result = 0;
+    for (const auto& label: labels) { result += label.hubs.size(); }
+    return result;
+}
+} // namespace
+
+HubLabels::HubLabels(const Hierarchy& hierarchy) {
+    const auto n = hierarchy.size();
+    std::vector<Index> order(n);
+    for (Index v = 0; v < n; v += 1) { order[n - 1 - hierarchy.rank(v)] = v; }
+
+    std::vector<Builder> forward(n), backward(n);
+    for (auto v: order) {
+        forward[v] = merge(v, hierarchy.up()[v], forward, backward, true);
+        backward[v] = merge(v, hierarchy.down()[v], backward, forward, false);
+    }
+
+    const auto forward_entries = entries(forward), backward_entries = entries(backward);
+    const auto bytes = 8 * HEADER + section(n, forward_entries) + section(n, backward_entries);
+    auto buffer = std::make_shared<std::vector<std::uint64_t>>(bytes / 8);
+
+    auto* header = buffer->data();
+    header[0] = MAGIC, header[1] = n, header[2] = forward_entries, header[3] = backward_entries;
+    header[4] = hierarchy.fingerprint();
+    auto* data = reinterpret_cast<char*>(header + HEADER);
+    data = flatten(data, forward);
+    flatten(data, backward);
+
+    attach(reinterpret_cast<const char*>(buffer->data()));
+    m_storage = std::move(buffer);
+}
+
+std::size_t HubLabels::attach(const char* data) {
+    const auto* header = reinterpret_cast<const std::uint64_t*>(data);
+    m_data = data;
+    m_size = header[1];
+
+    const auto resolve = [&](const char* position, std::size_t entries, Direction& direction) {
+        direction.offsets = reinterpret_cast<const std::uint64_t*>(position);
+        position += 8 * (m_size + 1);
+        direction.hubs = reinterpret_cast<const Index*>(position);
+        position += aligned(sizeof(Index) * entries);
+        direction.distances = reinterpret_cast<const Distance*>(position);
+        return position + sizeof(Distance) * entries;
+    };
+    auto* position = data + 8 * HEADER;
+    position = resolve(position, header[2], m_forward);
+    position = resolve(position, header[3], m_backward);
+    m_bytes = position - data;
+    return m_bytes;
+}
+
+bool HubLabels::serialize(const fs::path& filename) const {
+    auto cname = filename;
+    cname.concat("-hl.dmp");
+    std::ofstream binary { cname, std::ios::out | std::ios::binary };
+    binary.write(m_data, static_cast<std::streamsize>(m_bytes));
+    return binary.good();
+}
+
+bool HubLabels::deserialize(const fs::path& filename, std::uint64_t fingerprint) {
+    auto cname = filename;
+    cname.concat("-hl.dmp");
+    if (!std::filesystem::exists(cname)) { return false; }
+
+    auto file = std::make_shared<boost::iostreams::mapped_file_source>(cname.string());
+    const auto* header = reinterpret_cast<const std::uint64_t*>(file->data());
+    if (file->size() < 8 * HEADER || header[0] != MAGIC || header[4] != fingerprint) {
+        return false;
+    }
+    if (attach(file->data()) > file->size()) {
+        *this = HubLabels {};
+        return false;
+    }
+    m_storage = std::move(file);
+    return true;
+}
+
+Distance HubLabels::join(const Label& lhs, const Label& rhs) {
+    auto best = Graph::INF;
+    std::size_t i = 0, j = 0;
+
+#ifdef __SSE2__
+    // Compare blocks of four hubs against each rotation of the other block.
+    const auto check = [&](__m128i hubs, __m128i rotated, std::size_t rotation) {
+        auto mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(hubs, rotated)));
+        while (mask != 0) {
+            const auto k = static_cast<std::size_t>(__builtin_ctz(mask));
+            mask &= mask - 1;
+            best = std::min(best, lhs.distances[i + k] + rhs.distances[j + (k + rotation) % 4]);
+        }
+    };
+    while (i + 4 <= lhs.size && j + 4 <= rhs.size) {
+        const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lhs.hubs + i));
+        const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rhs.hubs + j));
+        check(a, b, 0);
+        check(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1)), 1);
+        check(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2)), 2);
+        check(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3)), 3);
+
+        const auto last_a = lhs.hubs[i + 3], last_b = rhs.hubs[j + 3];
+        if (last_a <= last_b) { i += 4; }
+        if (last_b <= last_a) { j += 4; }
+    }
+#endif
+
+    while (i < lhs.size && j < rhs.size) {
+        if (lhs.hubs[i] < rhs.hubs[j]) {
+            i += 1;
+        } else if (rhs.hubs[j] < lhs.hubs[i]) {
+            j += 1;
+        } else {
+            best = std::min(best, lhs.distances[i] + rhs.distances[j]);
+            i += 1, j += 1;
+        }
+    }
+    return best;
+}
+} // namespace graphs
@@ -0,0 +1,174 @@
+#include "landmarks.hpp"
+
+#include <random>
+#include <algorithm>
+
+#include <boost/serialization/vector.hpp>
+
+namespace graphs {
+bool Landmarks::serialize(const fs::path& filename) const {
+    auto cname = filename;
+    cname.concat("-alt.dmp");
+    std::ofstream binary { cname, std::ios::out | std::ios::binary };
+    boost::archive::binary_oarchive archive { binary, boost::archive::no_header };
+    archive << m_fingerprint << m_landmarks << m_from << m_to;
+    return true;
+}
+
+bool Landmarks::deserialize(const fs::path& filename, std::uint64_t fingerprint) {
+    auto cname = filename;
+    cname.concat("-alt.dmp");
+    if (!std::filesystem::exists(cname)) { return false; }
+    std::ifstream binary { cname, std::ios::binary };
+    boost::archive::binary_iarchive archive { binary, boost::archive::no_header };
+    archive >> m_fingerprint;
+    if (m_fingerprint != fingerprint) {
+        *this = Landmarks {};
+        return false;
+    }
+    archive >> m_landmarks >> m_from >> m_to;
+    return true;
+}
+} // namespace graphs
+
+namespace graphs {
+namespace {
+using Index = Graph::Index;
+
+/**
+ * Reached node with the maximal distance, NONE if nothing but the source is reached.
+ */
+auto furthest(const ShortestPaths& distances) -> Index {
+    auto result = Graph::NONE;
+    for (Index v = 0; v < distances.size(); v += 1) {
+        if (distances[v] < Graph::INF && distances[v] > 0
+            && (result == Graph::NONE || distances[v] > distances[result])) {
+            result = v;
+        }
+    }
+    return result;
+}
+} // namespace
+
+Landmarks::Landmarks(const Graph& graph, std::size_t count, Selection selection)
+    : m_fingerprint(graph.fingerprint()) {
+    if (graph.size() == 0) { return; }
+    count = std::min(count, graph.size());
+
+    // Fixed seed keeps the tables reproducible between imports.
+    std::mt19937 random { 0 };
+    auto start = static_cast<Index>(random() % graph.size());
+    const auto first = furthest(graph.dijkstra(start).first);
+    add(graph, first == Graph::NONE ? start : first);
+
+    // Maximise the distance to the closest landmark.
+    const auto farthest = [&]() {
+        auto result = Graph::NONE;
+        Distance best = 0;
+        const auto k = m_landmarks.size();
+        for (Index v = 0; v < graph.size(); v += 1) {
+            auto closest = Graph::INF;
+            for (std::size_t i = 0; i < k; i += 1) {
+                closest = std::min(closest, m_from[v * k + i]);
+            }
+            if (closest < Graph::INF && closest > best) { best = closest, result = v; }
+        }
+        return result;
+    };
+
+    /*
+     * Weight of a node is the gap between its distance from a random root and the current
+     * bound of it; size of a subtree sums the weights unless it holds a landmark.
+     * Descend from the root into the largest subtree, its leaf is the next landmark.
+     */
+    const auto avoid = [&]() {
+        const auto root = static_cast<Index>(random() % graph.size());
+        const auto[distances, previous] = graph.dijkstra(root);
+
+        std::vector<std::vector<Index>> children(graph.size());
+        for (Index v = 0; v < graph.size(); v += 1) {
+            if (previous[v] != Graph::NONE) { children[previous[v]].push_back(v); }
+        }
+        std::vector<Index> order { root }, stack { root };
+        while (!stack.empty()) {
+            const auto v = stack.back();
+            stack.pop_back();
+            for (auto c: children[v]) { order.push_back(c), stack.push_back(c); }
+        }
+
+        std::vector<bool> holds(graph.size(), false);
+        for (auto l: m_landmarks) { holds[l] = true; }
+        std::vector<Distance> size(graph.size(), 0);
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            const auto v = *it;
+            size[v] += distances[v] - bound(root, v);
+            for (auto c: children[v]) {
+                holds[v] = holds[v] || holds[c];
+                size[v] += size[c];
+            }
+            if (holds[v]) { size[v] = 0; }
+        }
+
+        auto v = root;
+        while (!children[v].empty()) {
+            const auto child = *std::max_element(
+                children[v].begin(), children[v].end(),
+                [&](auto lhs, auto rhs) { return size[lhs] < size[rhs]; });
+            if (size[child] <= 0) { break; }
+            v = child;
+        }
+        return size[v] > 0 ? v : Graph::NONE;
+    };
+
+    while (m_landmarks.size() < count) {
+        // Root may see landmarks in all of its subtrees, the farthest node is picked then.
+        auto next = selection == Selection::Avoid ? avoid() : Graph::NONE;
+        if (next == Graph::NONE) { next = farthest(); }
+
+        // Nothing left to improve: the graph is covered by fewer landmarks.
+        if (next == Graph::NONE) { break; }
+        add(graph, next);
+    }
+}
+
+void Landmarks::add(const Graph& graph, Index landmark) {
+    const auto from = graph.dijkstra(landmark).first;
+    const auto to = graph.reverse_dijkstra(landmark).first;
+
+    // Widen the node-major rows by one column.
+    const auto k = m_landmarks.size();
+    ShortestPaths wide_from, wide_to;
+    wide_from.reserve(graph.size() * (k + 1));
+    wide_to.reserve(graph.size() * (k + 1));
+    for (Index v = 0; v < graph.size(); v += 1) {
+        wide_from.insert(wide_from.end(), m_from.begin() + v * k, m_from.begin() + (v + 1) * k);
+        wide_from.push_back(from[v]);
+        wide_to.insert(wide_to.end(), m_to.begin() + v * k, m_to.begin() + (v + 1) * k);
+        wide_to.push_back(to[v]);
+    }
+    m_from = std::move(wide_from);
+    m_to = std::move(wide_to);
+    m_landmarks.push_back(landmark);
+}
+
+Distance Landmarks::bound(Index from, Index to) const {
+    constexpr auto INF = Graph::INF;
+    const auto k = count();
+    const auto* from_v = m_from.data() + from * k;
+    const auto* from_t = m_from.data() + to * k;
+    const auto* to_v = m_to.data() + from * k;
+    const auto* to_t = m_to.data() + to * k;
+
+    Distance result = 0;
+    for (std::size_t i = 0; i < k; i += 1) {
+        // Nodes unreachable from or to the landmark tell nothing.
+        if (from_t[i] < INF && from_v[i] < INF) {
+            result = std::max(result, from_t[i] - from_v[i]);
+        }
+        if (to_v[i] < INF && to_t[i] < INF) {
+            result = std::max(result, to_v[i] - to_t[i]);
+        }
+    }
+    return result * SLACK;
+}
+} // namespace graphs
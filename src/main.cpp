@@ -9,6 +9,7 @@
 #include "map.hpp"
 #include "assessment.hpp"
 #include "planning.hpp"
+#include "scheduler.hpp"
 
 namespace fs = std::filesystem;
 
@@ -44,6 +45,23 @@ int main(int argc, const char** argv) {
            .default_value(false)
            .implicit_value(true);
 
+    program.add_argument("-l", "--labels")
+           .help("build hub labels for the distance tables")
+           .default_value(false)
+           .implicit_value(true);
+
+    program.add_argument("-a", "--landmarks")
+           .help("select landmarks for goal-directed search")
+           .default_value(false)
+           .implicit_value(true);
+
+    program.add_argument("-t", "--threads")
+           .help("number of worker threads for the queries")
+           .default_value(std::max(1u, std::thread::hardware_concurrency()))
+           .action([](const std::string& value) {
+               return static_cast<unsigned>(std::max(1, std::stoi(value)));
+           });
+
     try {
         program.parse_args(argc, argv);
     }
@@ -52,6 +70,8 @@ int main(int argc, const char** argv) {
         exit(0);
     }
 
+    graphs::Scheduler::configure(program.get<unsigned>("--threads"));
+
     if (!fs::exists(".cache")) { fs::create_directory(".cache"); }
     fs::path filename = program.get<std::string>("--import");
     auto extension = filename.extension();
@@ -62,17 +82,20 @@ int main(int argc, const char** argv) {
         map = import_map_from_csv(filename);
         auto paths = map.dijkstra(Node { 0 });
         fmt::print("From: {}\n", 0);
-        for (const auto& path: paths) {
-            auto[to, d] = path;
-            fmt::print("\tto: {} ({} m)\n", to.id(), d);
+        for (size_t to = 0; to < paths.size(); to += 1) {
+            fmt::print("\tto: {} ({} m)\n", map.nodes()[to].id(), paths[to]);
         }
     } else if (extension == ".pbf") {
         auto cache_name = filename.stem();
         auto recache = program["--recache"] == true
                        || !fs::exists((fs::path { ".cache" } / cache_name) += "-map.dmp")
                        || !fs::exists((fs::path { ".cache" } / cache_name) += "-gph.dmp");
+        // Structures missing from the cache are built on their own, the map is not imported again.
+        graphs::Map::Preprocessing preprocessing {};
+        preprocessing.labels = program["--labels"] == true;
+        preprocessing.landmarks = program["--landmarks"] == true;
         auto houses = program.get<int>("houses"), facilities = program.get<int>("facilities");
-        if (auto result = graphs::import_map_from_pbf(filename, recache)) {
+        if (auto result = graphs::import_map_from_pbf(filename, recache, preprocessing)) {
             map = result.value();
         } else {
             fmt::print(stderr, "Map not found");
@@ -80,13 +103,10 @@ int main(int argc, const char** argv) {
         }
 
         /*
-         * Start tasks in separate threads.
+         * Run tasks on the shared workers, together with the queries they spread over them.
          */
-        auto first = std::thread { assessment, std::ref(map), houses, facilities };
-        auto second = std::thread { planning, std::ref(map), houses, facilities };
-
-        first.join();
-        second.join();
+        graphs::Scheduler::instance().invoke([&] { assessment(map, houses, facilities); },
+                                             [&] { planning(map, houses, facilities); });
     } else {
         fmt::print(stderr, "Map format not recognised");
         return 1;
@@ -1,14 +1,12 @@
 #include "map.hpp"
 
-#include <unordered_map>
-#include <unordered_set>
+#include <algorithm>
 #include <functional>
 #include <numeric>
 #include <random>
 #include <filesystem>
 
 #include <boost/iostreams/stream.hpp>
-#include <boost/serialization/unordered_map.hpp>
 #include <boost/serialization/vector.hpp>
 
 #include <osmium/osm/types.hpp>
@@ -20,6 +18,9 @@
 
 #include "d99kris/rapidcsv.h"
 
+#include "scheduler.hpp"
+#include "flat_map.hpp"
+
 /*
  * Map serialization.
  */
@@ -27,14 +28,58 @@ namespace graphs {
 bool Map::serialize(const fs::path& filename) const {
     auto cname = filename;
     cname.concat("-map.dmp");
-    return ::graphs::serialize(cname, m_buildings) && m_graph.serialize(filename);
+    {
+        std::ofstream binary { cname, std::ios::out | std::ios::binary | std::ios::app };
+        boost::archive::binary_oarchive archive { binary, boost::archive::no_header };
+        archive << COORDINATES_FORMAT << m_buildings;
+    }
+    return m_graph.serialize(filename)
+           && (m_hierarchy.empty() || m_hierarchy.serialize(filename))
+           && (m_customizable.empty() || m_customizable.serialize(filename))
+           && (m_landmarks.empty() || m_landmarks.serialize(filename))
+           && (m_labels.empty() || m_labels.serialize(filename));
 };
 
+void Map::preprocess(const Preprocessing& preprocessing, const fs::path& filename) {
+    if ((preprocessing.hierarchy || preprocessing.labels) && m_hierarchy.empty()) {
+        contract();
+        m_hierarchy.serialize(filename);
+    }
+    if (preprocessing.labels && m_labels.empty()) {
+        build_labels();
+        m_labels.serialize(filename);
+    }
+    if (preprocessing.landmarks && m_landmarks.empty()) {
+        select_landmarks();
+        m_landmarks.serialize(filename);
+    }
+}
+
 bool Map::deserialize(const fs::path& filename) {
     auto cname = filename;
     cname.concat("-map.dmp");
     if (!std::filesystem::exists(cname)) { return false; }
-    return ::graphs::deserialize(cname, m_buildings) && m_graph.deserialize(filename);
+    {
+        std::ifstream binary { cname, std::ios::binary };
+        boost::archive::binary_iarchive archive { binary, boost::archive::no_header };
+        std::uint64_t format = 0;
+        archive >> format;
+        // Dump of another coordinates layout, the map has to be imported again.
+        if (format != COORDINATES_FORMAT) { return false; }
+        archive >> m_buildings;
+    }
+    if (!m_graph.deserialize(filename)) { return false; }
+    index_buildings();
+
+    // Dumps of a different graph are dropped, the structures stay empty until rebuilt.
+    const auto fingerprint = m_graph.fingerprint();
+    // Hierarchy is optional, sweep order is cheap to derive from it.
+    if (m_hierarchy.deserialize(filename, fingerprint)) { m_phast = Phast { m_hierarchy }; }
+    // Only the order is stored, it waits for customize() as after preparation.
+    m_customizable.deserialize(filename, fingerprint);
+    m_landmarks.deserialize(filename, fingerprint);
+    m_labels.deserialize(filename, fingerprint);
+    return true;
 };
 } // namespace graphs
 
@@ -74,59 +119,354 @@ auto Map::select_random_houses(size_t num) const -> Buildings {
     });
 };
 
-auto Map::shortest_paths(Building from, const Buildings& to) const -> Paths {
-    auto[distances, trail] = m_graph.dijkstra(from.closest());
+auto Map::closest_nodes(const Buildings& buildings) const -> std::vector<Graph::Index> {
+    std::vector<Graph::Index> result;
+    result.reserve(buildings.size());
+    for (const auto& building: buildings) { result.push_back(m_graph.index(building.closest())); }
+    return result;
+}
+
+namespace {
+/**
+ * Search state of the calling thread, reused by all its queries.
+ */
+auto workspace(const Graph& graph) -> Workspace<>& {
+    thread_local Workspace<> instance;
+    instance.fit(graph.size());
+    return instance;
+}
+
+/**
+ * Rows of a hub labels distance table per task.
+ */
+constexpr size_t LABEL_ROWS = 64;
+
+/**
+ * Fewest sources of a many-to-many block, smaller ones would mostly repeat target searches.
+ */
+constexpr size_t MIN_BLOCK = 16;
+} // namespace
+
+auto Map::shortest_paths(Building from, const Buildings& to, Distance cutoff) const -> Paths {
+    const auto targets = closest_nodes(to);
+    auto& search = workspace(m_graph);
+    m_graph.dijkstra(m_graph.index(from.closest()), search, targets, cutoff);
     Paths result {};
 
-    for (const auto& building: to) {
-        auto node_to = building.closest();
-        auto distance = distances.at(node_to);
-        result.emplace_back(from, building, distance);
+    for (size_t i = 0; i < to.size(); i += 1) {
+        result.emplace_back(from, to[i], search.distance(targets[i]));
+    }
+
+    return result;
+}
+
+auto Map::shortest_paths_with_trace(Building from, const Buildings& to,
+                                    Distance cutoff) const -> TracedPaths {
+    const auto source = m_graph.index(from.closest());
+    const auto targets = closest_nodes(to);
+    auto& search = workspace(m_graph);
+    m_graph.dijkstra(source, search, targets, cutoff);
+    return traced_paths(from, to, targets,
+                        [&](auto v) { return search.distance(v); },
+                        [&](auto v) { return search.previous(v); });
+}
+
+Map::Voronoi::Voronoi(const Map& map, Buildings sites, Graph::Direction direction)
+    : m_map(map)
+    , m_sites(std::move(sites))
+    , m_direction(direction) {
+    std::tie(m_distances, m_owners) = map.m_graph.voronoi(map.closest_nodes(m_sites), direction);
+}
+
+auto Map::Voronoi::nearest(const Building& building) const -> Path {
+    const auto v = m_map.m_graph.index(building.closest());
+    if (m_owners[v] == Graph::NONE) { return { building, building, Graph::INF }; }
+    const auto& site = m_sites[m_owners[v]];
+    if (m_direction == Graph::Direction::Forward) { return { site, building, m_distances[v] }; }
+    return { building, site, m_distances[v] };
+}
+
+auto Map::voronoi(const Buildings& sites, Graph::Direction direction) const -> Voronoi {
+    return { *this, sites, direction };
+}
+
+auto Map::shortest_paths_to(const Buildings& from, Building to,
+                            Distance cutoff) const -> Paths {
+    const auto sources = closest_nodes(from);
+    auto& search = workspace(m_graph);
+    m_graph.reverse_dijkstra(m_graph.index(to.closest()), search, sources, cutoff);
+    Paths result {};
+
+    for (size_t i = 0; i < from.size(); i += 1) {
+        result.emplace_back(from[i], to, search.distance(sources[i]));
+    }
+
+    return result;
+}
+
+void Map::index_buildings() {
+    // Buildings whose node is not routable are left out.
+    m_residents_offsets.assign(m_graph.size() + 1, 0);
+    for (const auto& building: m_buildings) {
+        if (m_graph.contains(building.closest())) {
+            m_residents_offsets[m_graph.index(building.closest()) + 1] += 1;
+        }
+    }
+    std::partial_sum(m_residents_offsets.begin(), m_residents_offsets.end(),
+                     m_residents_offsets.begin());
+
+    m_residents.resize(m_residents_offsets.back());
+    auto position = m_residents_offsets;
+    for (std::uint32_t i = 0; i < m_buildings.size(); i += 1) {
+        if (m_graph.contains(m_buildings[i].closest())) {
+            m_residents[position[m_graph.index(m_buildings[i].closest())]++] = i;
+        }
+    }
+}
+
+auto Map::buildings_within(Building from, Distance radius) const -> Paths {
+    Paths result {};
+    auto& search = workspace(m_graph);
+    for (const auto&[v, d]: m_graph.within(m_graph.index(from.closest()), radius, search)) {
+        for (auto i = m_residents_offsets[v]; i < m_residents_offsets[v + 1]; i += 1) {
+            result.emplace_back(from, m_buildings[m_residents[i]], d);
+        }
+    }
+    return result;
+}
+
+auto Map::isochrones(Building from, std::vector<Distance> cutoffs,
+                     double concavity) const -> Isochrones {
+    Isochrones result {};
+    if (cutoffs.empty()) { return result; }
+    std::sort(cutoffs.begin(), cutoffs.end());
+    auto& search = workspace(m_graph);
+    const auto reached = m_graph.within(m_graph.index(from.closest()), cutoffs.back(), search);
+
+    // Edge falls into the band of the first cutoff its far end is within.
+    std::vector<std::vector<Isochrone::Segment>> bands(cutoffs.size());
+    for (const auto&[v, d]: reached) {
+        for (const auto&[to, length]: m_graph.edges(v)) {
+            const auto band = std::lower_bound(cutoffs.cbegin(), cutoffs.cend(), d + length);
+            if (band == cutoffs.cend()) { continue; }
+            bands[band - cutoffs.cbegin()].emplace_back(m_graph.node(v), m_graph.node(to));
+        }
+    }
+
+    // Nodes are reached in the order of distance, so every band extends the previous one.
+    Locations locations;
+    auto next = reached.cbegin();
+    for (size_t i = 0; i < cutoffs.size(); i += 1) {
+        for (; next != reached.cend() && next->second <= cutoffs[i]; ++next) {
+            locations.push_back(m_graph.node(next->first).location());
+        }
+        result.emplace_back(cutoffs[i], std::move(bands[i]), concave_hull(locations, concavity));
+    }
+    return result;
+}
+
+auto Map::round_trips(Building from, const Buildings& to) const -> Paths {
+    // Way there by a search along the edges, way back by a single one against them.
+    const auto there = shortest_paths(from, to);
+    const auto back = shortest_paths_to(to, from);
+    Paths result {};
+    for (size_t i = 0; i < to.size(); i += 1) {
+        const auto x = there[i].distance(), y = back[i].distance();
+        result.emplace_back(from, to[i], x < Graph::INF && y < Graph::INF ? x + y : Graph::INF);
     }
 
     return result;
 }
 
-auto Map::shortest_paths_with_trace(Building from, const Buildings& to) const -> TracedPaths {
-    auto[distances, trail] = m_graph.dijkstra(from.closest());
+auto Map::goal_directed_paths(Building from, const Buildings& to,
+                              Heuristic heuristic, Distance cutoff) const -> TracedPaths {
+    const auto source = m_graph.index(from.closest());
+    const auto targets = closest_nodes(to);
+    if (heuristic == Heuristic::Landmarks && m_landmarks.empty()) {
+        heuristic = Heuristic::Haversine;
+    }
+
+    std::pair<ShortestPaths, Graph::Trail> tree;
+    switch (heuristic) {
+        case Heuristic::Haversine:
+            tree = m_graph.astar(source, targets, HaversinePotential { m_graph, targets }, cutoff);
+            break;
+        case Heuristic::Equirectangular:
+            tree = m_graph.astar(source, targets, EquirectangularPotential { m_graph, targets },
+                                 cutoff);
+            break;
+        case Heuristic::Landmarks:
+            tree = m_graph.astar(source, targets, LandmarkPotential { m_landmarks, targets },
+                                 cutoff);
+            break;
+    }
+    const auto&[distances, trail] = tree;
+    return traced_paths(from, to, targets,
+                        [&](auto v) { return distances[v]; },
+                        [&](auto v) { return trail[v]; });
+}
+
+template<typename Distances, typename Trail>
+auto Map::traced_paths(Building from, const Buildings& to,
+                       const std::vector<Graph::Index>& targets,
+                       const Distances& distances,
+                       const Trail& trail) const -> TracedPaths {
+    const auto source = m_graph.index(from.closest());
     TracedPaths result {};
 
-    for (const auto& building: to) {
-        auto node_to = building.closest(), node_from = from.closest();
-        auto distance = distances.at(node_to);
+    for (size_t i = 0; i < to.size(); i += 1) {
+        const auto target = targets[i];
+        auto distance = distances(target);
 
-        // Reconstruct path.
+        // Reconstruct path, unreachable buildings get an empty one.
         std::vector<Node> path;
-        for (auto v = node_to; v != from.closest(); v = trail[v]) {
-            path.push_back(v);
+        if (distance < Graph::INF) {
+            for (auto v = target; v != source; v = trail(v)) {
+                path.push_back(m_graph.node(v));
+            }
+            path.push_back(m_graph.node(source));
+            reverse(path.begin(), path.end());
         }
-        path.push_back(node_from);
-        reverse(path.begin(), path.end());
 
         // Build path in place.
-        result.emplace_back(from, building, path, distance);
+        result.emplace_back(from, to[i], path, distance);
     }
 
     return result;
 }
 
+auto Map::route(Graph::Index s, Graph::Index t) const -> std::pair<Distance, Graph::Route> {
+    if (m_customizable.customized()) { return m_customizable.query(s, t); }
+    if (!m_hierarchy.empty()) { return m_hierarchy.query(s, t); }
+    if (m_landmarks.empty()) { return m_graph.bidirectional(s, t); }
+
+    const auto[distances, trail] = m_graph.astar(s, { t }, LandmarkPotential { m_landmarks, { t }});
+    Graph::Route route;
+    if (distances[t] == Graph::INF) { return { Graph::INF, route }; }
+    for (auto v = t; v != Graph::NONE; v = trail[v]) { route.push_back(v); }
+    std::reverse(route.begin(), route.end());
+    return { distances[t], route };
+}
+
+auto Map::distance(Building from, Building to) const -> Path {
+    if (!m_labels.empty() && !m_customizable.customized()) {
+        return { from, to, m_labels.distance(m_graph.index(from.closest()),
+                                             m_graph.index(to.closest())) };
+    }
+    auto[distance, _] = route(m_graph.index(from.closest()), m_graph.index(to.closest()));
+    return { from, to, distance };
+}
+
+auto Map::distance_with_trace(Building from, Building to) const -> TracedPath {
+    auto[distance, route] = this->route(m_graph.index(from.closest()),
+                                        m_graph.index(to.closest()));
+    Nodes path;
+    path.reserve(route.size());
+    for (auto v: route) { path.push_back(m_graph.node(v)); }
+    return { from, to, path, distance };
+}
+
+auto Map::distance_table(const Buildings& from,
+                         const Buildings& to) const -> std::vector<Paths> {
+    auto& scheduler = Scheduler::instance();
+    const auto sources = closest_nodes(from), targets = closest_nodes(to);
+    std::vector<Paths> result(from.size());
+    const auto row = [&](size_t i, auto&& distance) {
+        result[i].reserve(to.size());
+        for (size_t j = 0; j < to.size(); j += 1) {
+            result[i].emplace_back(from[i], to[j], distance(j));
+        }
+    };
+
+    // Every block repeats the backward searches from the targets, so there is one per thread:
+    // the workers and the caller, which runs the first block itself.
+    const auto threads = scheduler.size() + 1;
+    const auto block = std::max(MIN_BLOCK, (from.size() + threads - 1) / threads);
+
+    if (const auto metric = m_customizable.metric(); metric) {
+        // Blocks share one metric, so the table is consistent during a customization.
+        scheduler.parallel_for(from.size(), block, [&](size_t begin, size_t end) {
+            const auto table = m_customizable.many_to_many({ sources.begin() + begin,
+                                                             sources.begin() + end },
+                                                           targets, *metric);
+            for (auto i = begin; i < end; i += 1) {
+                row(i, [&](size_t j) { return table[i - begin][j]; });
+            }
+        });
+        return result;
+    }
+    if (!m_labels.empty()) {
+        scheduler.parallel_for(from.size(), LABEL_ROWS, [&](size_t begin, size_t end) {
+            for (auto i = begin; i < end; i += 1) {
+                const auto label = m_labels.forward(sources[i]);
+                row(i, [&](size_t j) {
+                    return HubLabels::join(label, m_labels.backward(targets[j]));
+                });
+            }
+        });
+        return result;
+    }
+    if (m_hierarchy.empty() && from.size() <= Graph::LANES) {
+        for (size_t i = 0; i < from.size(); i += 1) { result[i] = shortest_paths(from[i], to); }
+        return result;
+    }
+    if (m_hierarchy.empty()) {
+        // Batches of nearby sources are searched together, and independently of each other.
+        const auto order = m_graph.z_order(sources);
+        scheduler.parallel_for(from.size(), Graph::LANES, [&](size_t begin, size_t end) {
+            std::vector<Graph::Index> batch_sources;
+            for (auto i = begin; i < end; i += 1) { batch_sources.push_back(sources[order[i]]); }
+            const auto batch = m_graph.batched_dijkstra(batch_sources);
+            for (auto i = begin; i < end; i += 1) {
+                row(order[i], [&](size_t j) { return batch[i - begin][targets[j]]; });
+            }
+        });
+        return result;
+    }
+
+    scheduler.parallel_for(from.size(), block, [&](size_t begin, size_t end) {
+        const auto table = m_hierarchy.many_to_many({ sources.begin() + begin,
+                                                      sources.begin() + end }, targets);
+        for (auto i = begin; i < end; i += 1) {
+            row(i, [&](size_t j) { return table[i - begin][j]; });
+        }
+    });
+    return result;
+}
+
 auto Map::weights_sum() const -> long double {
-    return std::accumulate(nodes().cbegin(), nodes().cend(), static_cast<long double>(0),
-                           [](auto lhs, const auto& node) {
-                               return lhs +
-                                      std::accumulate(node.second.cbegin(), node.second.cend(),
-                                                      static_cast<long double>(0),
-                                                      [](auto lhs, const auto& edge) {
-                                                          return lhs + edge.second;
-                                                      });
-                           });
+    return std::accumulate(m_graph.weights().cbegin(), m_graph.weights().cend(),
+                           static_cast<long double>(0));
 }
 
 auto Map::dijkstra(const Node& s) -> ShortestPaths {
-    auto[paths, trail] = m_graph.dijkstra(s);
+    if (!m_phast.empty()) { return m_phast.distances(m_graph.index(s)); }
+    auto[paths, trail] = m_graph.delta_stepping(m_graph.index(s), Scheduler::instance());
     return paths;
 }
 
+auto Map::dijkstra(const Nodes& sources) const -> std::vector<ShortestPaths> {
+    std::vector<Graph::Index> indices;
+    indices.reserve(sources.size());
+    for (const auto& s: sources) { indices.push_back(m_graph.index(s)); }
+
+    auto& scheduler = Scheduler::instance();
+    std::vector<ShortestPaths> result(indices.size());
+    if (m_phast.empty()) {
+        for (size_t i = 0; i < indices.size(); i += 1) {
+            result[i] = m_graph.delta_stepping(indices[i], scheduler).first;
+        }
+        return result;
+    }
+
+    // Sweeps of different batches are independent.
+    scheduler.parallel_for(indices.size(), Phast::LANES, [&](size_t begin, size_t end) {
+        auto batch = m_phast.distances({ indices.begin() + begin, indices.begin() + end });
+        std::move(batch.begin(), batch.end(), result.begin() + begin);
+    });
+    return result;
+}
+
 bool export_map_to_csv(const Map& map, const fs::path& filename) {
     /*
      * Adjacency list.
@@ -137,10 +477,11 @@ bool export_map_to_csv(const Map& map, const fs::path& filename) {
 
         csv.SetRow(-1, std::vector<std::string> { "from", "to", "distance" });
         size_t num = 0;
-        for (const auto&[from, edge]: map.nodes()) {
-            for (const auto&[to, d]: edge) {
-                csv.SetCell(0, num, from.id());
-                csv.SetCell(1, num, to.id());
+        const auto& graph = map.graph();
+        for (Graph::Index from = 0; from < graph.size(); from += 1) {
+            for (const auto&[to, d]: graph.edges(from)) {
+                csv.SetCell(0, num, graph.node(from).id());
+                csv.SetCell(1, num, graph.node(to).id());
                 csv.SetCell(2, num, d);
                 num += 1;
             }
@@ -155,26 +496,23 @@ bool export_map_to_csv(const Map& map, const fs::path& filename) {
     {
         auto csv_name = fs::path { "Matrix-" } += (filename);
         std::ofstream file { csv_name };
-        std::unordered_map<uint64_t, size_t> iti; // ID to index.
+        const auto& graph = map.graph();
+        const auto num = graph.size();
 
-        size_t num = 1;
         file << ','; // Cell (0, 0).
-        for (const auto&[node, _]: map.nodes()) {
-            file << node.id() << ','; // Columns `to`.
-            iti[node.id()] = num;
-            num += 1;
+        for (Graph::Index to = 0; to < num; to += 1) {
+            file << graph.nodes().id(to) << ','; // Columns `to`.
         }
         file << '\n';
 
-        for (const auto&[from, edge]: map.nodes()) {
-            file << from.id() << ','; // Rows `from`.
-            std::vector<std::string> nodes(num, "");
-            for (const auto&[to, d]: edge) {
-                nodes[iti[to.id()]] = std::to_string(d);
-            }
+        std::vector<std::string> row(num, "");
+        for (Graph::Index from = 0; from < num; from += 1) {
+            file << graph.node(from).id() << ','; // Rows `from`.
+            for (const auto&[to, d]: graph.edges(from)) { row[to] = std::to_string(d); }
             for (size_t i = 0; i < num; i += 1) {
-                file << nodes[i] << ',';
+                file << row[i] << ',';
             }
+            for (const auto&[to, _]: graph.edges(from)) { row[to].clear(); }
             file << '\n';
         }
 
@@ -197,59 +535,71 @@ auto import_map_from_csv(const fs::path& filename) -> Map {
         }
     }
 
-    return Map {{}, graph };
+    Map map {{}, graph };
+    map.contract();
+    return map;
 }
 
 Map paths_to_map(const Map& map, const Map::TracedPaths& paths) {
-    std::unordered_set<Building> set;
+    FlatMap<Building, bool> seen;
     Buildings buildings;
     Graph routes;
+    const auto& graph = map.graph();
 
     for (const auto& path: paths) {
         auto[from, to] = path.ends();
-        set.insert(from);
-        set.insert(to);
+        for (const auto& building: { from, to }) {
+            if (seen.try_emplace(building).second) { buildings.push_back(building); }
+        }
 
+        if (path.path().empty()) { continue; }
         auto pred = *path.path().begin();
         for (const auto curr: path.path()) {
             if (curr == pred) { continue; }
-            auto weight = map.nodes().find(pred)->second.find(curr)->second;
+            auto weight = graph.weight(graph.index(pred), graph.index(curr));
             routes.add_edge_one_way({ pred, curr }, weight);
             pred = curr;
         }
     }
 
-    buildings.insert(buildings.end(), set.begin(), set.end());
-
     return Map { buildings, routes };
 }
 
-auto import_map_from_pbf(const fs::path& filename, bool recache) -> std::optional<Map> {
-    using NodesMarker = std::unordered_map<std::uint64_t, bool>;
-    using NodesLocation = std::unordered_map<Node, Location>;
+auto import_map_from_pbf(const fs::path& filename, bool recache,
+                         const Map::Preprocessing& preprocessing) -> std::optional<Map> {
+    /*
+     * Every node of a highway gets a dense index on the first pass,
+     * so the per-node flags are a plain array instead of a hash map.
+     */
+    using NodesIndex = FlatMap<osmium::object_id_type, std::uint32_t>;
+    using NodesMarker = std::vector<bool>;
 
     struct CountHandler: public osmium::handler::Handler {
+        NodesIndex indices {};
         NodesMarker marked {};
+        std::size_t ways = 0;
 
         void way(const osmium::Way& way) noexcept {
             // Throw away unrelated nodes
             if (!way.tags().has_key("highway")) { return; }
+            ways += 1;
 
             for (const auto& node: way.nodes()) {
+                auto[it, inserted] = indices.insert({ node.ref(), marked.size() });
                 // If the node lies on an intersection, mark it
-                if (marked.find(node.ref()) != marked.end()) {
-                    marked[node.ref()] |= true;
+                if (inserted) {
+                    marked.push_back(false);
                 } else {
-                    marked.insert({ node.ref(), false });
+                    marked[it->second] = true;
                 }
             }
         }
     };
 
     struct GraphHandler: public osmium::handler::Handler {
+        NodesIndex indices;
         NodesMarker marked;
         Graph routes {};
-        NodesLocation locations {};
 
         void way(const osmium::Way& way) noexcept {
             if (!way.tags().has_key("highway")) { return; }
@@ -266,9 +616,8 @@ auto import_map_from_pbf(const fs::path& filename, bool recache) -> std::optiona
 
             for (const auto& curr: way.nodes()) {
                 Distance distance = 0;
-                locations.insert({ make_node(curr), make_pos(curr) });
                 if (curr.ref() != first->ref() && curr.ref() != last->ref()) {
-                    if (marked.at(curr.ref())) {
+                    if (marked[indices.at(curr.ref())]) {
                         distance += haversine(make_pos(*pred), make_pos(curr));
                         one_way
                         ? routes.add_edge_one_way({ make_node(*mrkd), make_node(curr) }, distance)
@@ -290,21 +639,26 @@ auto import_map_from_pbf(const fs::path& filename, bool recache) -> std::optiona
 
     struct MapHandler: public osmium::handler::Handler {
         Graph routes;
-        NodesLocation locations;
         Buildings buildings {};
 
         void way(const osmium::Way& way) noexcept {
             if (!way.tags().has_key("building")) { return; }
+            // Building without a single located node has no place on the map.
+            if (std::none_of(way.nodes().cbegin(), way.nodes().cend(),
+                             [](const auto& node) { return node.location().valid(); })) {
+                return;
+            }
 
             const auto location = barycenter(way.nodes());
             // Get reference to the closest node
-            auto node = std::min_element(routes.nodes().cbegin(), routes.nodes().cend(),
-                                         [&](const auto& lhs, const auto& rhs) {
-                                             return
-                                                 haversine(locations[lhs.first], location) <
-                                                 haversine(locations[rhs.first], location);
-                                         })->first;
-            auto building = make_building(way, location, node);
+            const auto& nodes = routes.nodes();
+            Graph::Index closest = 0;
+            auto best = Graph::INF;
+            for (Graph::Index v = 0; v < nodes.size(); v += 1) {
+                const auto distance = haversine(nodes.location(v), location);
+                if (distance < best) { closest = v, best = distance; }
+            }
+            auto building = make_building(way, location, nodes[closest]);
             buildings.push_back(building);
         }
     };
@@ -316,14 +670,19 @@ auto import_map_from_pbf(const fs::path& filename, bool recache) -> std::optiona
     auto cname = fs::path { ".cache" } /= filename.stem();
 
     /*
-     * If using cached map, return.
+     * If using cached map of the current layout, return.
      */
     if (!recache) {
         Map map {};
-        if (map.deserialize(cname)) { return map; }
-        else { return std::nullopt; }
+        if (map.deserialize(cname)) {
+            map.preprocess(preprocessing, cname);
+            return map;
+        }
     }
 
+    // Cache is missing or of an older layout, import from the file.
+    if (!fs::exists(filename)) { return std::nullopt; }
+
     fs::remove_all(".cache");
     fs::create_directory(".cache");
 
@@ -334,11 +693,15 @@ auto import_map_from_pbf(const fs::path& filename, bool recache) -> std::optiona
     CountHandler ch;
     osmium::apply(cr, ch);
 
-    GraphHandler fh {{}, std::move(ch.marked) };
+    // Graph nodes are the marked ones and the ends of the ways, at most.
+    const auto ends = std::count(ch.marked.begin(), ch.marked.end(), true) + 2 * ch.ways;
+    GraphHandler fh {{}, std::move(ch.indices), std::move(ch.marked) };
+    fh.routes.reserve(ends);
     LocationHandler lhf { index };
     osmium::apply(fr, lhf, fh);
 
-    MapHandler gh {{}, std::move(fh.routes), std::move(fh.locations) };
+    fh.routes.freeze();
+    MapHandler gh {{}, std::move(fh.routes) };
     LocationHandler lhg { index };
     osmium::apply(gr, lhg, gh);
 
@@ -346,9 +709,10 @@ auto import_map_from_pbf(const fs::path& filename, bool recache) -> std::optiona
     fr.close();
     gr.close();
 
-    // Create map and serialize
+    // Create map, serialize, then prepare speed-up structures and serialize them one by one
     Map map { gh.buildings, gh.routes };
     map.serialize(cname);
+    map.preprocess(preprocessing, cname);
 
     return map;
 }
@@ -0,0 +1,93 @@
+#include "phast.hpp"
+
+#include <algorithm>
+
+#include "heap.hpp"
+
+namespace graphs {
+Phast::Phast(const Hierarchy& hierarchy)
+    : m_position(hierarchy.size()) {
+    const auto n = hierarchy.size();
+
+    // Highest rank is swept first.
+    std::vector<Index> order(n);
+    for (Index v = 0; v < n; v += 1) {
+        m_position[v] = static_cast<Index>(n - 1 - hierarchy.rank(v));
+        order[m_position[v]] = v;
+    }
+
+    const auto pack = [&](const Hierarchy::Adjacency& arcs, Adjacency& result) {
+        result.offsets.reserve(n + 1);
+        for (auto v: order) {
+            for (const auto& e: arcs[v]) {
+                result.nodes.push_back(m_position[e.node]);
+                result.weights.push_back(e.weight);
+            }
+            result.offsets.push_back(static_cast<Index>(result.nodes.size()));
+        }
+    };
+    pack(hierarchy.up(), m_up);
+    pack(hierarchy.down(), m_down);
+}
+
+template<std::size_t Lanes>
+void Phast::sweep(const Index* sources, std::size_t count, std::vector<Distance>& labels) const {
+    const auto n = size();
+    labels.assign(n * Lanes, Graph::INF);
+
+    // Upward searches, each in its own lane of the labels.
+    QuaternaryHeap queue { n };
+    for (std::size_t k = 0; k < count; k += 1) {
+        const auto s = m_position[sources[k]];
+        labels[s * Lanes + k] = 0;
+        queue.push(s, 0);
+        while (!queue.empty()) {
+            auto[d, p] = queue.pop();
+            for (auto i = m_up.offsets[p]; i < m_up.offsets[p + 1]; i += 1) {
+                auto& label = labels[m_up.nodes[i] * Lanes + k];
+                if (d + m_up.weights[i] < label) {
+                    label = d + m_up.weights[i];
+                    queue.push(m_up.nodes[i], label);
+                }
+            }
+        }
+    }
+
+    // Downward arcs come from lower positions, which are final by the time p is swept.
+    for (std::size_t p = 0; p < n; p += 1) {
+        auto* target = labels.data() + p * Lanes;
+        for (auto i = m_down.offsets[p]; i < m_down.offsets[p + 1]; i += 1) {
+            const auto* source = labels.data() + std::size_t { m_down.nodes[i] } * Lanes;
+            const auto weight = m_down.weights[i];
+            for (std::size_t k = 0; k < Lanes; k += 1) {
+                target[k] = std::min(target[k], source[k] + weight);
+            }
+        }
+    }
+}
+
+auto Phast::distances(Index s) const -> ShortestPaths {
+    std::vector<Distance> labels;
+    sweep<1>(&s, 1, labels);
+    ShortestPaths result(size());
+    for (Index v = 0; v < size(); v += 1) { result[v] = labels[m_position[v]]; }
+    return result;
+}
+
+auto Phast::distances(const std::vector<Index>& sources) const -> std::vector<ShortestPaths> {
+    std::vector<ShortestPaths> result(sources.size());
+    std::vector<Distance> labels;
+    for (std::size_t first = 0; first < sources.size(); first += LANES) {
+        const auto count = std::min(LANES, sources.size() - first);
+        sweep<LANES>(sources.data() + first, count, labels);
+        for (std::size_t k = 0; k < count; k += 1) {
+            auto& distances = result[first + k];
+            distances.resize(size());
+            for (Index v = 0; v < size(); v += 1) {
+                distances[v] = labels[std::size_t { m_position[v] } * LANES + k];
+            }
+        }
+    }
+    return result;
+}
+} // namespace graphs
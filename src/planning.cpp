@@ -3,6 +3,7 @@
 #include "clustering.hpp"
 #include "dmatrix.hpp"
 #include "geojson.hpp"
+#include "scheduler.hpp"
 
 using namespace graphs;
 
@@ -21,25 +22,39 @@ auto shortest_paths_tree(const Map& map, Building facility,
     return { tree, shortest_paths_sum };
 }
 
-auto clusters(const Map& map, Buildings& houses, size_t clusters_num) {
+auto clusters(const Map& map, const Buildings& houses, size_t clusters_num) {
     auto dmatrix = dmatrix_for_buildings(map, houses);
     ClusterStructure cl_st(map, Buildings(houses), move(dmatrix));
-
-    auto features = geojson::cluster_structure_to_features(cl_st);
-    auto collection = geojson::FeatureCollection();
-    collection.insert(features);
-    geojson::dump_to_file(collection, "dendrogram.geojson");
+    auto& scheduler = Scheduler::instance();
 
     auto clusters = get_k_clusters(cl_st, clusters_num);
     Colors colors = generate_colors(clusters.size());
 
-    collection = geojson::FeatureCollection();
+    // Trees of the clusters are built in parallel and reported in the order of the clusters.
+    std::vector<std::pair<Map, double>> trees(clusters.size());
+    std::vector<geojson::Features> trees_features(clusters.size());
+    scheduler.invoke(
+        [&] {
+            auto features = geojson::cluster_structure_to_features(cl_st);
+            auto collection = geojson::FeatureCollection();
+            collection.insert(features);
+            geojson::dump_to_file(collection, "dendrogram.geojson");
+        },
+        [&] {
+            scheduler.parallel_for(clusters.size(), 1, [&](size_t begin, size_t end) {
+                for (auto i = begin; i < end; i += 1) {
+                    trees[i] = shortest_paths_tree(map, clusters[i].centroid(),
+                                                   cl_st.get_elements(clusters[i].id()));
+                    trees_features[i] = geojson::map_to_features(trees[i].first, colors[i]);
+                }
+            });
+        });
+
+    auto collection = geojson::FeatureCollection();
     double sp_sum = 0, spt_sum = 0;
     for (size_t i = 0; i < clusters.size(); ++i) {
-        houses = cl_st.get_elements(clusters[i].id());
-        auto[tree, shortest_paths_sum] = shortest_paths_tree(map, clusters[i].centroid(), houses);
-        features = geojson::map_to_features(tree, colors[i]);
-        collection.insert(features);
+        const auto&[tree, shortest_paths_sum] = trees[i];
+        collection.insert(trees_features[i]);
         std::cout << "Cluster " << clusters[i].id() << std::endl;
         std::cout << "Shortest paths sum: " << shortest_paths_sum << std::endl;
         auto shortest_paths_tree_sum = tree.weights_sum();
@@ -62,8 +77,11 @@ void planning(const Map& map, int houses_num, int clusters_num) {
     std::cout << "Shortest paths sum: " << shortest_paths_sum << std::endl;
     std::cout << "Shortest paths tree sum: " << tree.weights_sum() << std::endl;
 
-    auto collection = geojson::map_to_geojson(tree);
-    dump_to_file(collection, "shortest_path_tree.geojson");
-
-    clusters(map, houses, clusters_num);
+    // Writing out the tree does not hold up the clustering.
+    Scheduler::instance().invoke(
+        [&, &tree = tree] {
+            auto collection = geojson::map_to_geojson(tree);
+            dump_to_file(collection, "shortest_path_tree.geojson");
+        },
+        [&] { clusters(map, houses, clusters_num); });
 }
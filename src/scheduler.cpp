@@ -0,0 +1,84 @@
+#include "scheduler.hpp"
+
+namespace graphs {
+namespace {
+/**
+ * Scheduler and deque of the calling thread if it is a worker.
+ */
+thread_local const Scheduler* t_owner = nullptr;
+thread_local unsigned t_index = 0;
+
+std::atomic<unsigned> g_threads { 0 };
+} // namespace
+
+Scheduler& Scheduler::instance() {
+    static Scheduler scheduler { g_threads.load() != 0
+                                 ? g_threads.load()
+                                 : std::max(1u, std::thread::hardware_concurrency()) };
+    return scheduler;
+}
+
+void Scheduler::configure(unsigned threads) { g_threads.store(threads); }
+
+Scheduler::Scheduler(unsigned threads) {
+    for (unsigned i = 0; i < threads; i += 1) { m_queues.push_back(std::make_unique<Queue>()); }
+    for (unsigned i = 0; i < threads; i += 1) { m_workers.emplace_back([this, i] { work(i); }); }
+}
+
+Scheduler::~Scheduler() {
+    {
+        std::lock_guard lock { m_mutex };
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto& worker: m_workers) { worker.join(); }
+}
+
+void Scheduler::submit(Task task) {
+    const auto index = t_owner == this ? t_index : m_next.fetch_add(1) % size();
+    {
+        std::lock_guard lock { m_queues[index]->mutex };
+        m_queues[index]->tasks.push_back(std::move(task));
+    }
+    {
+        // Counter changes under the lock, so a worker cannot miss the wake-up.
+        std::lock_guard lock { m_mutex };
+        m_queued.fetch_add(1);
+    }
+    m_wake.notify_one();
+}
+
+bool Scheduler::run_one() {
+    const auto own = t_owner == this ? t_index : 0;
+    Task task;
+    for (unsigned k = 0; k < size() && !task; k += 1) {
+        const auto index = (own + k) % size();
+        auto& queue = *m_queues[index];
+        std::lock_guard lock { queue.mutex };
+        if (queue.tasks.empty()) { continue; }
+        // Own tasks are taken LIFO for locality, stolen ones FIFO as they are the largest.
+        if (t_owner == this && index == own) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+    if (!task) { return false; }
+    m_queued.fetch_sub(1);
+    task();
+    return true;
+}
+
+void Scheduler::work(unsigned index) {
+    t_owner = this;
+    t_index = index;
+    while (true) {
+        if (run_one()) { continue; }
+        std::unique_lock lock { m_mutex };
+        m_wake.wait(lock, [this] { return m_stop || m_queued.load() > 0; });
+        if (m_stop) { return; }
+    }
+}
+} // namespace graphs